@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+//! \brief Alignment used for all buffers handed to the SIMD kernels.
+constexpr size_t SIMD_ALIGNMENT = 32;
+
+//! \brief Minimal allocator returning memory aligned to \p Alignment bytes.
+//!
+//! Only used for buffers that are sized once (when a plan is built) so the
+//! audio and render paths never hit the heap.
+template<typename T, size_t Alignment = SIMD_ALIGNMENT>
+class AlignedAllocator
+{
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(size_t n)
+    {
+        void* ptr = nullptr;
+#if defined(_WIN32)
+        ptr = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+        if (posix_memalign(&ptr, Alignment, n * sizeof(T)) != 0)
+            ptr = nullptr;
+#endif
+        if (!ptr)
+            throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t) noexcept
+    {
+#if defined(_WIN32)
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+template<typename T>
+using aligned_vector = std::vector<T, AlignedAllocator<T>>;
@@ -0,0 +1,197 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "analyser.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+// Factor applied to the levels for every hop skipped by the silence gate
+constexpr float SILENCE_DECAY = 0.7f;
+constexpr float SILENCE_CUTOFF = 0.01f;
+
+// Speaker positions in the order Kodi delivers them for common layouts
+enum Speaker { FL, FR, FC, LFE, BL, BR, BC, SL, SR };
+
+void build_downmix(size_t channels, float* coeffs)
+{
+  static const Speaker layouts[][DOWNMIX_MAX_CHANNELS] =
+  {
+    {FL, FR, FC},                         // 3.0
+    {FL, FR, BL, BR},                     // 4.0
+    {FL, FR, FC, BL, BR},                 // 5.0
+    {FL, FR, FC, LFE, BL, BR},            // 5.1
+    {FL, FR, FC, LFE, BC, SL, SR},        // 6.1
+    {FL, FR, FC, LFE, BL, BR, SL, SR},    // 7.1
+  };
+
+  std::fill(coeffs, coeffs + 2 * DOWNMIX_MAX_CHANNELS, 0.0f);
+  const Speaker* layout = layouts[std::min<size_t>(channels, DOWNMIX_MAX_CHANNELS) - 3];
+
+  float* left = coeffs;
+  float* right = coeffs + DOWNMIX_MAX_CHANNELS;
+  for (size_t c = 0; c < channels && c < DOWNMIX_MAX_CHANNELS; c++)
+  {
+    switch (layout[c])
+    {
+    case FL:
+      left[c] = 1.0f;
+      break;
+    case FR:
+      right[c] = 1.0f;
+      break;
+    case BL:
+    case SL:
+      left[c] = 0.7071f;
+      break;
+    case BR:
+    case SR:
+      right[c] = 0.7071f;
+      break;
+    case FC:
+    case BC:
+      left[c] = right[c] = 0.7071f;
+      break;
+    case LFE:
+      left[c] = right[c] = 0.5f;
+      break;
+    }
+  }
+
+  // Normalize so a full scale signal on all channels stays at full scale
+  float leftSum = 0.0f, rightSum = 0.0f;
+  for (size_t c = 0; c < DOWNMIX_MAX_CHANNELS; c++)
+  {
+    leftSum += left[c];
+    rightSum += right[c];
+  }
+  for (size_t c = 0; c < DOWNMIX_MAX_CHANNELS; c++)
+  {
+    left[c] /= leftSum;
+    right[c] /= rightSum;
+  }
+}
+
+} // namespace
+
+void CSpectrumAnalyser::configure(size_t fftSize, size_t hop, int sampleRate, size_t channels,
+                                  size_t barCount, MRFFT::Window window)
+{
+  channels = std::max<size_t>(1, channels);
+  const size_t analysed = channels == 1 ? 1 : 2;
+
+  if (m_engine && fftSize == m_fftSize && analysed == m_channels && sampleRate == m_sampleRate &&
+      barCount == m_barCount && window == m_window)
+  {
+    // Only the hop or the downmix changed, keep the ring and engine
+    m_hop = std::max<size_t>(1, std::min(hop, fftSize));
+    m_inputChannels = channels;
+    if (channels > 2)
+      build_downmix(channels, m_downmix);
+    return;
+  }
+
+  m_fftSize = fftSize;
+  m_hop = std::max<size_t>(1, std::min(hop, fftSize));
+  m_inputChannels = channels;
+  m_channels = analysed;
+  m_sampleRate = sampleRate;
+  m_barCount = barCount;
+  m_window = window;
+
+  if (channels > 2)
+    build_downmix(channels, m_downmix);
+
+  m_ring.assign(2 * analysed * fftSize, 0.0f);
+  m_levels.assign(barCount, 0.0f);
+  m_levelsAtFloor = true;
+  m_writePos = 0;
+  m_filled = 0;
+  m_pending = 0;
+
+  m_engine.reset(new CFFTEngine(fftSize, sampleRate, analysed, barCount, window));
+}
+
+void CSpectrumAnalyser::write(const float* samples, size_t frames)
+{
+  float* first = m_ring.data() + m_channels * m_writePos;
+  float* mirror = first + m_channels * m_fftSize;
+
+  if (m_inputChannels > 2)
+    get_kernels().downmix(samples, m_inputChannels, m_downmix, first, frames);
+  else
+    memcpy(first, samples, m_channels * frames * sizeof(float));
+
+  memcpy(mirror, first, m_channels * frames * sizeof(float));
+}
+
+bool CSpectrumAnalyser::process(const float* samples, size_t frames)
+{
+  if (!m_engine)
+    return false;
+
+  // More than a full window in one go: only the newest part matters
+  if (frames > m_fftSize)
+  {
+    samples += m_inputChannels * (frames - m_fftSize);
+    m_pending += frames - m_fftSize;
+    frames = m_fftSize;
+  }
+
+  while (frames)
+  {
+    const size_t count = std::min(frames, m_fftSize - m_writePos);
+    write(samples, count);
+
+    m_writePos = (m_writePos + count) % m_fftSize;
+    m_filled = std::min(m_filled + count, m_fftSize);
+    m_pending += count;
+    samples += m_inputChannels * count;
+    frames -= count;
+  }
+
+  const size_t hop = m_hop * m_hopStride.load(std::memory_order_relaxed);
+  if (m_filled < m_fftSize || m_pending < hop)
+    return false;
+
+  // Keep the hop cadence even if a callback covered several hops; only the
+  // newest window gets analysed.
+  m_pending %= hop;
+
+  const float* window = m_ring.data() + m_channels * m_writePos;
+
+  // With any of our windows the normalized magnitude of a bin is at most
+  // twice the peak of the window, so below the threshold the engine could
+  // only produce empty bars.
+  if (get_kernels().peak(window, m_channels * m_fftSize) < m_silenceThreshold)
+  {
+    m_skippedCount++;
+
+    // Nothing new to publish once all bars reached the floor
+    if (m_levelsAtFloor)
+      return false;
+
+    m_levelsAtFloor = true;
+    for (auto& level : m_levels)
+    {
+      level = level * SILENCE_DECAY;
+      if (level < SILENCE_CUTOFF)
+        level = 0.0f;
+      else
+        m_levelsAtFloor = false;
+    }
+    return true;
+  }
+
+  m_analysedCount++;
+  m_levelsAtFloor = false;
+  m_engine->analyse(window, m_levels.data());
+  return true;
+}
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "aligned.h"
+#include "engines.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+//! \brief Fixed-size sliding-window spectrum analyser.
+//!
+//! Samples are appended to a ring buffer as they arrive, independent of how
+//! Kodi chunks them. Once "hop" new frames are available a fixed-size FFT is
+//! run over the newest window and reduced to bar levels, so time and frequency
+//! resolution no longer depend on the player's callback length.
+//!
+//! Mono input is analysed with a single FFT, stereo with a packed two-for-one
+//! FFT and anything with more channels is downmixed to stereo on the way into
+//! the ring buffer.
+//!
+//! The window is handed to an ISpectrumEngine, which turns it into levels.
+//!
+//! A silence gate checks the peak of the window first. If nothing in it could
+//! rise above the floor of the bar scale the engine is skipped and the last
+//! levels decay towards zero instead.
+class CSpectrumAnalyser
+{
+public:
+  //! \brief Allocate the ring buffer and FFT plan.
+  //! \param fftSize Length of the analysis window in frames.
+  //! \param hop Number of new frames between two analyses.
+  //! \param sampleRate Sample rate of the incoming audio.
+  //! \param channels Number of interleaved channels of the incoming audio.
+  //! \param barCount Number of bar levels to produce.
+  //! \param window Window function applied before the FFT.
+  void configure(size_t fftSize, size_t hop, int sampleRate, size_t channels,
+                 size_t barCount, MRFFT::Window window);
+
+  //! \brief Append interleaved samples and analyse if a hop is due.
+  //! \param samples Interleaved data with the configured channel count.
+  //! \param frames Number of frames in samples.
+  //! \return true if levels() got updated.
+  bool process(const float* samples, size_t frames);
+
+  //! \brief bar_count() levels in [0, 1] of the last analysis.
+  const float* levels() const { return m_levels.data(); }
+
+  //! \brief Set the peak (linear, full scale = 1) below which a window
+  //!        counts as silent. 0 disables the gate.
+  void set_silence_threshold(float threshold) { m_silenceThreshold = threshold; }
+
+  //! \brief Only analyse every "stride"-th hop, to save time on slow
+  //!        devices. Safe to call while another thread runs process().
+  void set_hop_stride(size_t stride) { m_hopStride = std::max<size_t>(1, stride); }
+
+  //! \brief Number of hops analysed by the engine.
+  uint64_t analysed_count() const { return m_analysedCount; }
+
+  //! \brief Number of hops skipped by the silence gate.
+  uint64_t skipped_count() const { return m_skippedCount; }
+
+  size_t fft_size() const { return m_fftSize; }
+  size_t hop() const { return m_hop; }
+  size_t bar_count() const { return m_barCount; }
+  size_t input_channels() const { return m_inputChannels; }
+
+  //! \brief Name of the engine in use.
+  const char* engine_name() const { return m_engine ? m_engine->name() : ""; }
+
+private:
+  //! \brief Write frames into the ring at m_writePos (no wrap-around).
+  void write(const float* samples, size_t frames);
+
+  size_t m_fftSize = 0;
+  size_t m_hop = 0;
+  size_t m_inputChannels = 0;
+  size_t m_channels = 0;      //!< Channels analysed, 1 or 2
+  int m_sampleRate = 0;
+  size_t m_barCount = 0;
+  MRFFT::Window m_window = MRFFT::Window::None;
+
+  // Stereo downmix gains, see sKernels::downmix
+  float m_downmix[2 * DOWNMIX_MAX_CHANNELS] = {};
+
+  // Interleaved ring (m_channels wide) holding the last m_fftSize frames twice
+  // in a row, so the newest window is always contiguous at m_writePos.
+  aligned_vector<float> m_ring;
+  size_t m_writePos = 0;
+  size_t m_filled = 0;
+  size_t m_pending = 0;
+  std::atomic<size_t> m_hopStride{1};
+
+  std::unique_ptr<ISpectrumEngine> m_engine;
+  aligned_vector<float> m_levels;
+
+  // Half of CBarBinning::FLOOR_DB (as linear amplitude), so the gate never
+  // hides anything that would have shown up on the bars.
+  float m_silenceThreshold = 1.58e-4f;
+  bool m_levelsAtFloor = true;
+
+  std::atomic<uint64_t> m_analysedCount{0};
+  std::atomic<uint64_t> m_skippedCount{0};
+};
@@ -0,0 +1,255 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "barshader.h"
+#include "glversion.h"
+
+#include <vector>
+
+// Every bar is drawn as two quads of two triangles each
+static const int VERTICES_PER_BAR = 12;
+
+CBarShader::CBarShader(const glm::mat4& projMat, const glm::mat4& modelMat)
+  : m_projMat(projMat),
+    m_modelMat(modelMat)
+{
+}
+
+#if defined(HAS_GL)
+void CBarShader::build(int)
+{
+  // The vertex shader numbers the vertices itself (gl_VertexID)
+}
+#else
+void CBarShader::build(int count)
+{
+  std::vector<GLfloat> indices(VERTICES_PER_BAR * count);
+  for (size_t i = 0; i < indices.size(); i++)
+    indices[i] = static_cast<GLfloat>(i);
+
+  if (!m_indexVBO)
+    glGenBuffers(1, &m_indexVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, m_indexVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * indices.size(), indices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+#endif
+
+void CBarShader::release()
+{
+  if (m_indexVBO)
+  {
+    glDeleteBuffers(1, &m_indexVBO);
+    m_indexVBO = 0;
+  }
+}
+
+void CBarShader::draw(const GLfloat* heights, int count, GLfloat width, GLfloat bottomEdge)
+{
+  glUniform4fv(m_heightsLoc, (count + 3) / 4, heights);
+
+  glm::vec3 layout(width, bottomEdge, static_cast<GLfloat>(count));
+  if (layout != m_layout)
+  {
+    glUniform3fv(m_layoutLoc, 1, glm::value_ptr(layout));
+    m_layout = layout;
+  }
+
+#if defined(HAS_GL)
+  glDrawArrays(GL_TRIANGLES, 0, VERTICES_PER_BAR * count);
+#else
+  glBindBuffer(GL_ARRAY_BUFFER, m_indexVBO);
+  glVertexAttribPointer(m_hIndex, 1, GL_FLOAT, GL_FALSE, 0, 0);
+  glEnableVertexAttribArray(m_hIndex);
+  glDrawArrays(GL_TRIANGLES, 0, VERTICES_PER_BAR * count);
+  glDisableVertexAttribArray(m_hIndex);
+#endif
+}
+
+void CBarShader::OnCompiledAndLinked()
+{
+  m_projMatLoc = glGetUniformLocation(ProgramHandle(), "u_projectionMatrix");
+  m_modelViewMatLoc = glGetUniformLocation(ProgramHandle(), "u_modelViewMatrix");
+  m_heightsLoc = glGetUniformLocation(ProgramHandle(), "u_heights");
+  m_layoutLoc = glGetUniformLocation(ProgramHandle(), "u_layout");
+
+  m_hIndex = glGetAttribLocation(ProgramHandle(), "a_index");
+
+  // A (re)linked program starts with all uniforms zeroed
+  m_uniformsDirty = true;
+  m_layout = glm::vec3(0.0f);
+}
+
+bool CBarShader::OnEnabled()
+{
+  if (m_uniformsDirty)
+  {
+    glUniformMatrix4fv(m_projMatLoc, 1, GL_FALSE, glm::value_ptr(m_projMat));
+    glUniformMatrix4fv(m_modelViewMatLoc, 1, GL_FALSE, glm::value_ptr(m_modelMat));
+    m_uniformsDirty = false;
+  }
+
+  return true;
+}
+
+CInstancedBarShader::CInstancedBarShader(const glm::mat4& projMat, const glm::mat4& modelMat)
+  : m_projMat(projMat),
+    m_modelMat(modelMat)
+{
+}
+
+bool CInstancedBarShader::supported()
+{
+#if defined(HAS_GL)
+  // glVertexAttribDivisor is core since GL 3.3
+  return gl_version_at_least(3, 3);
+#elif defined(HAS_INSTANCING)
+  // A GLES 3 build may still end up with a GLES 2 context
+  return gl_version_at_least(3, 0);
+#else
+  return false;
+#endif
+}
+
+void CInstancedBarShader::build(int count, GLfloat width)
+{
+  /**
+   * Same layout as the vertex upload path (see "CVisPictureIt::build_bars"):
+   * "count" bars over "width", each with a gap of 1/4 of its slot on both
+   * sides.
+   */
+  GLfloat slot = width / count;
+  m_barWidth = slot / 2;
+
+  std::vector<GLfloat> offsets(count);
+  for (int i = 0; i < count; i++)
+    offsets[i] = (width * -1) + (i * slot) + (slot / 4);
+
+  static const GLfloat corners[8][3] =
+  {
+    {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f},
+    {0.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f},
+  };
+  if (!m_meshVBO)
+  {
+    glGenBuffers(1, &m_meshVBO);
+    glGenBuffers(1, &m_meshIndexVBO);
+    glGenBuffers(1, &m_offsetVBO);
+    glGenBuffers(1, &m_heightVBO);
+#if defined(HAS_INSTANCING)
+    glGenVertexArrays(1, &m_vao);
+#endif
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_meshVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, m_offsetVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * count, offsets.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, m_heightVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * count, nullptr, GL_STREAM_DRAW);
+
+#if defined(HAS_INSTANCING)
+  // Record the attributes, divisors and the index buffer in our own vertex
+  // array object, so drawing leaves the one bound by Kodi untouched
+  GLint previousVAO = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+  glBindVertexArray(m_vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_meshVBO);
+  glVertexAttribPointer(m_hCorner, 3, GL_FLOAT, GL_FALSE, 0, 0);
+  glEnableVertexAttribArray(m_hCorner);
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_offsetVBO);
+  glVertexAttribPointer(m_hOffset, 1, GL_FLOAT, GL_FALSE, 0, 0);
+  glVertexAttribDivisor(m_hOffset, 1);
+  glEnableVertexAttribArray(m_hOffset);
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_heightVBO);
+  glVertexAttribPointer(m_hHeight, 1, GL_FLOAT, GL_FALSE, 0, 0);
+  glVertexAttribDivisor(m_hHeight, 1);
+  glEnableVertexAttribArray(m_hHeight);
+
+  static const GLubyte indices[12] = {0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7};
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_meshIndexVBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+  glBindVertexArray(previousVAO);
+#endif
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CInstancedBarShader::release()
+{
+  if (m_meshVBO)
+  {
+    glDeleteBuffers(1, &m_meshVBO);
+    glDeleteBuffers(1, &m_meshIndexVBO);
+    glDeleteBuffers(1, &m_offsetVBO);
+    glDeleteBuffers(1, &m_heightVBO);
+    m_meshVBO = m_meshIndexVBO = m_offsetVBO = m_heightVBO = 0;
+#if defined(HAS_INSTANCING)
+    glDeleteVertexArrays(1, &m_vao);
+    m_vao = 0;
+#endif
+  }
+}
+
+#if defined(HAS_INSTANCING)
+void CInstancedBarShader::draw(const GLfloat* heights, int count, GLfloat bottomEdge)
+{
+  glm::vec2 layout(m_barWidth, bottomEdge);
+  if (layout != m_layout)
+  {
+    glUniform2fv(m_layoutLoc, 1, glm::value_ptr(layout));
+    m_layout = layout;
+  }
+
+  GLint previousVAO = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+  glBindVertexArray(m_vao);
+
+  // Orphan last frame's heights instead of waiting for the GPU to be done
+  // with them
+  glBindBuffer(GL_ARRAY_BUFFER, m_heightVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * count, heights, GL_STREAM_DRAW);
+  glDrawElementsInstanced(GL_TRIANGLES, 12, GL_UNSIGNED_BYTE, 0, count);
+
+  glBindVertexArray(previousVAO);
+}
+#else
+void CInstancedBarShader::draw(const GLfloat*, int, GLfloat)
+{
+  // Never selected without instancing, see "supported"
+}
+#endif
+
+void CInstancedBarShader::OnCompiledAndLinked()
+{
+  m_projMatLoc = glGetUniformLocation(ProgramHandle(), "u_projectionMatrix");
+  m_modelViewMatLoc = glGetUniformLocation(ProgramHandle(), "u_modelViewMatrix");
+  m_layoutLoc = glGetUniformLocation(ProgramHandle(), "u_layout");
+
+  m_hCorner = glGetAttribLocation(ProgramHandle(), "a_corner");
+  m_hOffset = glGetAttribLocation(ProgramHandle(), "a_offset");
+  m_hHeight = glGetAttribLocation(ProgramHandle(), "a_height");
+
+  // A (re)linked program starts with all uniforms zeroed
+  m_uniformsDirty = true;
+  m_layout = glm::vec2(0.0f);
+}
+
+bool CInstancedBarShader::OnEnabled()
+{
+  if (m_uniformsDirty)
+  {
+    glUniformMatrix4fv(m_projMatLoc, 1, GL_FALSE, glm::value_ptr(m_projMat));
+    glUniformMatrix4fv(m_modelViewMatLoc, 1, GL_FALSE, glm::value_ptr(m_modelMat));
+    m_uniformsDirty = false;
+  }
+
+  return true;
+}
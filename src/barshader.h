@@ -0,0 +1,128 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/gui/gl/GL.h>
+#include <kodi/gui/gl/Shader.h>
+#include <glm/gtc/type_ptr.hpp>
+
+// Instanced drawing is part of desktop GL and GLES 3.0, but not GLES 2.0
+#if defined(HAS_GL) || (defined(HAS_GLES) && HAS_GLES >= 3)
+#define HAS_INSTANCING 1
+#endif
+
+//! \brief Draws the spectrum bars from nothing but their heights.
+//!
+//! The vertex shader ("bars_vert.glsl") generates the two quads of every bar
+//! (the bar and its mirrored counterpart) from the index of the vertex, so a
+//! frame only uploads one float per bar instead of the whole mesh.
+class CBarShader : public kodi::gui::gl::CShaderProgram
+{
+public:
+  //! The most bars the shader has room for (see "u_heights")
+  static const int MAX_BARS = 256;
+
+  CBarShader(const glm::mat4& projMat, const glm::mat4& modelMat);
+
+  //! \brief Create the GL objects needed to draw "count" bars.
+  //! Must be called with a current context before "draw".
+  void build(int count);
+
+  //! \brief Delete the GL objects created by "build".
+  void release();
+
+  //! \brief Draw "count" bars.
+  //! The program must be bound (EnableShader).
+  //! \param heights One height per bar, padded to a multiple of four
+  //! \param width Half width of the spectrum
+  //! \param bottomEdge Where all bars start
+  void draw(const GLfloat* heights, int count, GLfloat width, GLfloat bottomEdge);
+
+  // kodi::gui::gl::CShaderProgram
+  void OnCompiledAndLinked() override;
+  bool OnEnabled() override;
+
+private:
+  const glm::mat4& m_projMat;
+  const glm::mat4& m_modelMat;
+
+  GLint m_projMatLoc = -1;
+  GLint m_modelViewMatLoc = -1;
+  GLint m_heightsLoc = -1;
+  GLint m_layoutLoc = -1;
+  GLint m_hIndex = -1;
+
+  // What the program currently holds, only changes get uploaded
+  bool m_uniformsDirty = true;
+  glm::vec3 m_layout{0.0f};
+
+  // Holds the vertex indices on GLES, whose shading language has no
+  // "gl_VertexID"
+  GLuint m_indexVBO = 0;
+};
+
+//! \brief Draws the spectrum bars as instances of one static bar mesh.
+//!
+//! The mesh holds the two quads of a bar (the bar and its mirrored
+//! counterpart) in unit coordinates, every instance gets its left edge and
+//! height from a per-instance attribute. Needs GL 3.3 or GLES 3.0, see
+//! "supported".
+class CInstancedBarShader : public kodi::gui::gl::CShaderProgram
+{
+public:
+  CInstancedBarShader(const glm::mat4& projMat, const glm::mat4& modelMat);
+
+  //! \brief Whether the current context can draw instanced with per-instance
+  //! attributes.
+  static bool supported();
+
+  //! \brief Create the GL objects needed to draw "count" bars.
+  //! Must be called with a current context before "draw", after the program
+  //! got linked.
+  //! \param width Half width of the spectrum
+  void build(int count, GLfloat width);
+
+  //! \brief Delete the GL objects created by "build".
+  void release();
+
+  //! \brief Draw "count" bars.
+  //! The program must be bound (EnableShader).
+  //! \param heights One height per bar
+  //! \param bottomEdge Where all bars start
+  void draw(const GLfloat* heights, int count, GLfloat bottomEdge);
+
+  // kodi::gui::gl::CShaderProgram
+  void OnCompiledAndLinked() override;
+  bool OnEnabled() override;
+
+private:
+  const glm::mat4& m_projMat;
+  const glm::mat4& m_modelMat;
+
+  GLint m_projMatLoc = -1;
+  GLint m_modelViewMatLoc = -1;
+  GLint m_layoutLoc = -1;
+  GLint m_hCorner = -1;
+  GLint m_hOffset = -1;
+  GLint m_hHeight = -1;
+
+  // What the program currently holds, only changes get uploaded
+  bool m_uniformsDirty = true;
+  glm::vec2 m_layout{0.0f};
+
+  // Width of a single bar without its gaps
+  GLfloat m_barWidth = 0.0f;
+
+  GLuint m_meshVBO = 0;
+  GLuint m_meshIndexVBO = 0;
+  GLuint m_offsetVBO = 0;
+  GLuint m_heightVBO = 0;
+
+  // Holds the attribute setup and the index buffer, see "build"
+  GLuint m_vao = 0;
+};
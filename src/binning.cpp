@@ -0,0 +1,92 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "binning.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool CBarBinning::configure(size_t fftSize, int sampleRate, size_t barCount, size_t channels)
+{
+  if (fftSize == m_fftSize && sampleRate == m_sampleRate && barCount == m_barCount &&
+      channels == m_channels)
+    return false;
+
+  m_fftSize = fftSize;
+  m_sampleRate = sampleRate;
+  m_barCount = barCount;
+  m_channels = channels;
+
+  m_firstBin.assign(barCount, 0);
+  m_binCount.assign(barCount, 1);
+
+  const size_t bins = fftSize / 2;
+  if (bins == 0 || sampleRate <= 0)
+    return true;
+
+  const float binWidth = static_cast<float>(sampleRate) / fftSize;
+
+  for (size_t i = 0; i < barCount; i++)
+  {
+    float lower = edge_frequency(i, barCount, sampleRate);
+    float upper = edge_frequency(i + 1, barCount, sampleRate);
+
+    size_t first = static_cast<size_t>(std::lround(lower / binWidth));
+    size_t last = static_cast<size_t>(std::lround(upper / binWidth));
+
+    first = std::min(std::max<size_t>(first, 1), bins - 1);
+    last = std::min(std::max(last, first + 1), bins);
+
+    m_firstBin[i] = static_cast<uint32_t>(first);
+    m_binCount[i] = static_cast<uint32_t>(last - first);
+  }
+
+  return true;
+}
+
+void CBarBinning::process(const float* spectrum, float* bars) const
+{
+  for (size_t i = 0; i < m_barCount; i++)
+  {
+    const float* bin = spectrum + m_channels * m_firstBin[i];
+    const size_t count = m_channels * m_binCount[i];
+
+    // Mean power of all channels over all bins of the bar
+    float power = 0.0f;
+    for (size_t j = 0; j < count; j++)
+      power += bin[j] * bin[j];
+    power /= count;
+
+    bars[i] = power_to_level(power);
+  }
+}
+
+float CBarBinning::edge_frequency(size_t edge, size_t barCount, int sampleRate)
+{
+  // Bar edges are spaced evenly on a log scale between MIN_ and MAX_FREQUENCY
+  const float maxFrequency = std::min(MAX_FREQUENCY, sampleRate / 2.0f);
+  const float ratio = maxFrequency / MIN_FREQUENCY;
+  return MIN_FREQUENCY * std::pow(ratio, static_cast<float>(edge) / barCount);
+}
+
+float CBarBinning::power_to_level(float power)
+{
+  // 20*log10(x) == 10*log10(x^2), so the power sum never needs a sqrt
+  static const float floorPower = std::pow(10.0f, FLOOR_DB / 10.0f);
+  if (power <= floorPower)
+    return 0.0f;
+
+  float level = 1.0f - (10.0f * std::log10(power)) / FLOOR_DB;
+  return std::min(level, 1.0f);
+}
+
+float CBarBinning::bar_frequency(size_t bar) const
+{
+  if (!m_fftSize)
+    return 0.0f;
+  return m_firstBin[bar] * static_cast<float>(m_sampleRate) / m_fftSize;
+}
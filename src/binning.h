@@ -0,0 +1,66 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "aligned.h"
+
+#include <cstddef>
+#include <cstdint>
+
+//! \brief Maps FFT bins onto a logarithmically spaced set of bars.
+//!
+//! The bin ranges of all bars are computed once per (FFT size, sample rate,
+//! bar count) in configure(), so process() is a single linear pass over the
+//! spectrum without any per-bin log() calls.
+class CBarBinning
+{
+public:
+  //! \brief Lowest frequency (Hz) shown by the first bar.
+  static constexpr float MIN_FREQUENCY = 40.0f;
+  //! \brief Highest frequency (Hz) shown by the last bar.
+  static constexpr float MAX_FREQUENCY = 16000.0f;
+  //! \brief Level (dB relative to full scale) mapped to an empty bar.
+  static constexpr float FLOOR_DB = -70.0f;
+
+  //! \brief Build the bin to bar table.
+  //! \param fftSize Length of time data for a single channel.
+  //! \param sampleRate Sample rate of the analysed audio.
+  //! \param barCount Number of bars to produce.
+  //! \param channels Number of interleaved channels in the spectrum.
+  //! \return false if the parameters didn't change and nothing was rebuilt.
+  bool configure(size_t fftSize, int sampleRate, size_t barCount, size_t channels = 2);
+
+  //! \brief Reduce a spectrum to bar levels.
+  //! \param spectrum fftSize/2 magnitudes per channel, interleaved, as
+  //!                 returned by MRFFT.
+  //! \param bars barCount levels in the range [0, 1].
+  void process(const float* spectrum, float* bars) const;
+
+  //! \brief Lower edge (Hz) of a bar.
+  float bar_frequency(size_t bar) const;
+
+  //! \brief Lower edge (Hz) of a bar on the ideal log scale.
+  //! \param edge Bar index, barCount gives the upper edge of the last bar.
+  static float edge_frequency(size_t edge, size_t barCount, int sampleRate);
+
+  //! \brief Map a mean power (squared normalized magnitude) to a bar level.
+  static float power_to_level(float power);
+
+  size_t bar_count() const { return m_barCount; }
+
+private:
+  size_t m_fftSize = 0;
+  int m_sampleRate = 0;
+  size_t m_barCount = 0;
+  size_t m_channels = 0;
+
+  // First bin and number of bins of each bar. Low bars may share a bin when
+  // the FFT resolution is coarser than the bar spacing.
+  aligned_vector<uint32_t> m_firstBin;
+  aligned_vector<uint32_t> m_binCount;
+};
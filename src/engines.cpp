@@ -0,0 +1,21 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "engines.h"
+
+CFFTEngine::CFFTEngine(size_t fftSize, int sampleRate, size_t channels, size_t barCount,
+                       MRFFT::Window window)
+  : m_transform(static_cast<int>(fftSize), window,
+                channels == 1 ? MRFFT::Mode::Mono : MRFFT::Mode::Packed)
+{
+  m_binning.configure(fftSize, sampleRate, barCount, channels);
+}
+
+void CFFTEngine::analyse(const float* window, float* levels)
+{
+  m_binning.process(m_transform.calc(window), levels);
+}
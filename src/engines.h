@@ -0,0 +1,46 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "aligned.h"
+#include "binning.h"
+#include "mrfft.h"
+
+//! \brief Turns one analysis window into bar levels.
+//!
+//! All engines take the same input (fftSize interleaved frames of one or two
+//! channels) and produce the same output, so CSpectrumAnalyser can use them
+//! interchangeably.
+class ISpectrumEngine
+{
+public:
+  virtual ~ISpectrumEngine() = default;
+
+  //! \brief Name used for logging.
+  virtual const char* name() const = 0;
+
+  //! \brief Compute bar levels of one window.
+  //! \param window fftSize frames of interleaved samples.
+  //! \param levels Receives barCount levels in [0, 1].
+  virtual void analyse(const float* window, float* levels) = 0;
+};
+
+//! \brief Full spectrum via MRFFT, reduced to bars by CBarBinning.
+class CFFTEngine : public ISpectrumEngine
+{
+public:
+  CFFTEngine(size_t fftSize, int sampleRate, size_t channels, size_t barCount,
+             MRFFT::Window window);
+
+  const char* name() const override { return "FFT"; }
+  void analyse(const float* window, float* levels) override;
+
+private:
+  MRFFT m_transform;
+  CBarBinning m_binning;
+};
@@ -0,0 +1,41 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/gui/gl/GL.h>
+
+#include <cstdio>
+
+// First line of every shader, the files leave it out so defines can be put
+// in front of them (see CShaderProgram::CompileAndLink)
+#if defined(HAS_GL)
+#define GLSL_VERSION "#version 130\n"
+#else
+#define GLSL_VERSION "#version 100\n"
+#endif
+
+//! \brief Whether the current context is at least version "major.minor".
+//! On GLES this compares against the OpenGL ES version of the context.
+inline bool gl_version_at_least(int major, int minor)
+{
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  int contextMajor = 0;
+  int contextMinor = 0;
+  if (!version)
+    return false;
+
+#if defined(HAS_GL)
+  if (sscanf(version, "%d.%d", &contextMajor, &contextMinor) != 2)
+    return false;
+#else
+  if (sscanf(version, "OpenGL ES %d.%d", &contextMajor, &contextMinor) != 2)
+    return false;
+#endif
+
+  return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
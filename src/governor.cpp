@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "governor.h"
+
+#include <algorithm>
+
+void CFrameGovernor::configure(float budgetMs, int maxLevel)
+{
+  m_budgetMs = std::max(0.0f, budgetMs);
+  m_maxLevel = std::max(0, maxLevel);
+  reset();
+}
+
+void CFrameGovernor::reset()
+{
+  m_level = 0;
+  m_sumMs = 0.0f;
+  m_frames = 0;
+  m_averageMs = 0.0f;
+  m_changed = false;
+  m_steppedUp = false;
+  m_upCooldownMs = UP_COOLDOWN_MS;
+}
+
+float CFrameGovernor::ms_between(Clock::time_point from, Clock::time_point to)
+{
+  return std::chrono::duration<float, std::milli>(to - from).count();
+}
+
+bool CFrameGovernor::update(float costMs, Clock::time_point now)
+{
+  if (!enabled())
+    return false;
+
+  m_sumMs += costMs;
+  if (++m_frames < WINDOW_FRAMES)
+    return false;
+
+  m_averageMs = m_sumMs / m_frames;
+  m_sumMs = 0.0f;
+  m_frames = 0;
+
+  const float sinceChange = m_changed ? ms_between(m_lastChange, now) : UP_COOLDOWN_MAX_MS;
+
+  if (m_averageMs > m_budgetMs && m_level < m_maxLevel && sinceChange >= DOWN_COOLDOWN_MS)
+  {
+    // The last step up didn't fit, wait longer before trying again
+    if (m_steppedUp && sinceChange < 2.0f * m_upCooldownMs)
+      m_upCooldownMs = std::min(2.0f * m_upCooldownMs, UP_COOLDOWN_MAX_MS);
+
+    m_level++;
+    m_steppedUp = false;
+  }
+  else if (m_averageMs < HEADROOM * m_budgetMs && m_level > 0 && sinceChange >= m_upCooldownMs)
+  {
+    m_level--;
+    m_steppedUp = true;
+  }
+  else
+  {
+    return false;
+  }
+
+  m_changed = true;
+  m_lastChange = now;
+  return true;
+}
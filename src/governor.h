@@ -0,0 +1,71 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "timeline.h"
+
+//! \brief Picks a quality level that keeps the frame cost within a budget.
+//!
+//! The cost of every frame is averaged over a window of frames. If the
+//! average exceeds the budget quality steps down one level, if it stays well
+//! below (under half the budget) quality steps back up one level. Stepping
+//! down waits a short cooldown after the last change, stepping up a longer
+//! one, which doubles whenever a step up had to be taken back right away.
+//! So a level that is just too expensive isn't retried every few seconds.
+//!
+//! What a level means is up to the caller, 0 is full quality and higher
+//! levels are cheaper.
+class CFrameGovernor
+{
+public:
+  using Clock = CTimeline::Clock;
+
+  //! \brief Set the budget and the lowest quality level.
+  //! \param budgetMs Frame cost to stay within, 0 disables the governor.
+  //! \param maxLevel Highest (cheapest) level to step down to.
+  void configure(float budgetMs, int maxLevel);
+
+  //! \brief Back to full quality, forgetting all measurements.
+  void reset();
+
+  //! \brief Account the cost of one frame.
+  //! \param costMs Time (in ms) the frame took.
+  //! \param now Time of the frame.
+  //! \return true if level() changed.
+  bool update(float costMs, Clock::time_point now);
+
+  bool enabled() const { return m_budgetMs > 0.0f; }
+  float budget_ms() const { return m_budgetMs; }
+  int level() const { return m_level; }
+
+  //! \brief Mean frame cost (in ms) of the window that led to the last
+  //! decision.
+  float average_ms() const { return m_averageMs; }
+
+private:
+  static const int WINDOW_FRAMES = 30;
+  static constexpr float HEADROOM = 0.5f;
+  static constexpr float DOWN_COOLDOWN_MS = 1000.0f;
+  static constexpr float UP_COOLDOWN_MS = 5000.0f;
+  static constexpr float UP_COOLDOWN_MAX_MS = 60000.0f;
+
+  static float ms_between(Clock::time_point from, Clock::time_point to);
+
+  float m_budgetMs = 0.0f;
+  int m_maxLevel = 0;
+  int m_level = 0;
+
+  float m_sumMs = 0.0f;
+  int m_frames = 0;
+  float m_averageMs = 0.0f;
+
+  bool m_changed = false;
+  Clock::time_point m_lastChange;
+  bool m_steppedUp = false;
+  float m_upCooldownMs = UP_COOLDOWN_MS;
+};
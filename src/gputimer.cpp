@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "gputimer.h"
+#include "glversion.h"
+
+void CGPUTimer::create()
+{
+  destroy();
+
+#if defined(HAS_GL)
+  // GLES only has timer queries as an extension (EXT_disjoint_timer_query)
+  if (!gl_version_at_least(3, 3))
+    return;
+
+  glGenQueries(QUERIES, m_queries);
+  m_available = true;
+#endif
+}
+
+void CGPUTimer::destroy()
+{
+#if defined(HAS_GL)
+  if (m_available)
+    glDeleteQueries(QUERIES, m_queries);
+#endif
+
+  for (int i = 0; i < QUERIES; i++)
+  {
+    m_queries[i] = 0;
+    m_pending[i] = false;
+  }
+  m_available = false;
+  m_active = false;
+  m_current = 0;
+  m_resultMs = -1.0f;
+}
+
+void CGPUTimer::begin()
+{
+#if defined(HAS_GL)
+  if (!m_available)
+    return;
+
+  // Collect whatever finished since, oldest first
+  for (int i = 1; i <= QUERIES; i++)
+  {
+    int slot = (m_current + i) % QUERIES;
+    if (!m_pending[slot])
+      continue;
+
+    GLint ready = 0;
+    glGetQueryObjectiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE, &ready);
+    if (!ready)
+      continue;
+
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(m_queries[slot], GL_QUERY_RESULT, &ns);
+    m_resultMs = ns / 1000000.0f;
+    m_pending[slot] = false;
+  }
+
+  m_current = (m_current + 1) % QUERIES;
+
+  // All queries still in flight: skip measuring this frame rather than wait
+  if (m_pending[m_current])
+    return;
+
+  glBeginQuery(GL_TIME_ELAPSED, m_queries[m_current]);
+  m_pending[m_current] = true;
+  m_active = true;
+#endif
+}
+
+void CGPUTimer::end()
+{
+#if defined(HAS_GL)
+  // "m_pending" may still be set from an older query in this slot, only end
+  // what "begin" actually started
+  if (m_active)
+  {
+    glEndQuery(GL_TIME_ELAPSED);
+    m_active = false;
+  }
+#endif
+}
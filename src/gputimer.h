@@ -0,0 +1,51 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/gui/gl/GL.h>
+
+//! \brief Measures how long the GPU spends on the commands of a frame.
+//!
+//! Uses GL_TIME_ELAPSED queries (desktop GL 3.3). Results are read a few
+//! frames later once the GPU got to them, so measuring never waits for the
+//! GPU. Without timer queries "result_ms" always reports -1.
+class CGPUTimer
+{
+public:
+  CGPUTimer() = default;
+  ~CGPUTimer() = default;
+  CGPUTimer(const CGPUTimer&) = delete;
+  CGPUTimer& operator=(const CGPUTimer&) = delete;
+
+  //! \brief Create the queries if the context supports them, must be called
+  //! with a current context.
+  void create();
+
+  //! \brief Delete the queries.
+  void destroy();
+
+  bool available() const { return m_available; }
+
+  //! \brief Start and stop measuring the current frame.
+  void begin();
+  void end();
+
+  //! \brief GPU time (in ms) of the newest frame whose result arrived,
+  //! -1 if there is none.
+  float result_ms() const { return m_resultMs; }
+
+private:
+  static const int QUERIES = 4;
+
+  bool m_available = false;
+  GLuint m_queries[QUERIES] = {};
+  bool m_pending[QUERIES] = {};
+  bool m_active = false;  //!< Whether "begin" started a query "end" has to stop
+  int m_current = 0;
+  float m_resultMs = -1.0f;
+};
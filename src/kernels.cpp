@@ -0,0 +1,631 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PI_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define PI_KERNELS_NEON 1
+#elif defined(__arm__) && defined(__linux__) && defined(__ARM_FP) && defined(__GNUC__) && \
+      !defined(__clang__) && __GNUC__ >= 8
+// 32-bit ARM built without -mfpu=neon, as most armhf distributions are: GCC
+// compiles only the NEON kernels for NEON and they run if the CPU has it.
+#define PI_KERNELS_NEON 1
+#define PI_KERNELS_NEON_PRAGMA 1
+#endif
+
+#if defined(PI_KERNELS_NEON)
+#if defined(PI_KERNELS_NEON_PRAGMA)
+#pragma GCC push_options
+#pragma GCC target("fpu=neon")
+#endif
+#include <arm_neon.h>
+#if defined(PI_KERNELS_NEON_PRAGMA)
+#pragma GCC pop_options
+#endif
+#if defined(__linux__) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions explicitly marked
+// for it, which keeps the rest of the add-on runnable on plain SSE2 CPUs.
+#if defined(PI_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PI_TARGET_SSE2 __attribute__((target("sse2")))
+#define PI_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PI_TARGET_SSE2
+#define PI_TARGET_AVX2
+#endif
+
+namespace
+{
+
+/*
+ * Scalar reference implementation
+ */
+void deinterleave_scalar(const float* input, float* left, float* right, size_t frames)
+{
+  for (size_t i = 0; i < frames; i++)
+  {
+    left[i] = input[2 * i];
+    right[i] = input[2 * i + 1];
+  }
+}
+
+void multiply_scalar(const float* a, const float* b, float* output, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+    output[i] = a[i] * b[i];
+}
+
+void magnitude_scalar(const float* left, const float* right, float* output, size_t bins, float scale)
+{
+  for (size_t i = 0; i < bins; i++)
+  {
+    output[2 * i] = std::sqrt(left[2 * i] * left[2 * i] + left[2 * i + 1] * left[2 * i + 1]) * scale;
+    output[2 * i + 1] = std::sqrt(right[2 * i] * right[2 * i] + right[2 * i + 1] * right[2 * i + 1]) * scale;
+  }
+}
+
+void magnitude_mono_scalar(const float* data, float* output, size_t bins, float scale)
+{
+  for (size_t i = 0; i < bins; i++)
+    output[i] = std::sqrt(data[2 * i] * data[2 * i] + data[2 * i + 1] * data[2 * i + 1]) * scale;
+}
+
+void downmix_scalar(const float* input, size_t channels, const float* coeffs, float* output, size_t frames)
+{
+  for (size_t i = 0; i < frames; i++)
+  {
+    float left = 0.0f;
+    float right = 0.0f;
+    for (size_t c = 0; c < channels && c < DOWNMIX_MAX_CHANNELS; c++)
+    {
+      left += input[c] * coeffs[c];
+      right += input[c] * coeffs[DOWNMIX_MAX_CHANNELS + c];
+    }
+    output[2 * i] = left;
+    output[2 * i + 1] = right;
+    input += channels;
+  }
+}
+
+float peak_scalar(const float* data, size_t count)
+{
+  float peak = 0.0f;
+  for (size_t i = 0; i < count; i++)
+    peak = std::max(peak, std::fabs(data[i]));
+  return peak;
+}
+
+void smooth_scalar(float* current, const float* target, size_t count, float rise, float fall)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    const float diff = target[i] - current[i];
+    current[i] += diff * (diff > 0.0f ? rise : fall);
+  }
+}
+
+#if defined(PI_KERNELS_X86)
+/*
+ * SSE2
+ */
+PI_TARGET_SSE2 void deinterleave_sse2(const float* input, float* left, float* right, size_t frames)
+{
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4)
+  {
+    __m128 a = _mm_loadu_ps(input + 2 * i);
+    __m128 b = _mm_loadu_ps(input + 2 * i + 4);
+    _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  deinterleave_scalar(input + 2 * i, left + i, right + i, frames - i);
+}
+
+PI_TARGET_SSE2 void multiply_sse2(const float* a, const float* b, float* output, size_t count)
+{
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(output + i, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  multiply_scalar(a + i, b + i, output + i, count - i);
+}
+
+PI_TARGET_SSE2 inline __m128 magnitude4_sse2(const float* data, __m128 scale)
+{
+  __m128 a = _mm_loadu_ps(data);
+  __m128 b = _mm_loadu_ps(data + 4);
+  a = _mm_mul_ps(a, a);
+  b = _mm_mul_ps(b, b);
+  __m128 sum = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+                          _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  return _mm_mul_ps(_mm_sqrt_ps(sum), scale);
+}
+
+PI_TARGET_SSE2 void magnitude_sse2(const float* left, const float* right, float* output, size_t bins, float scale)
+{
+  const __m128 vscale = _mm_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 4 <= bins; i += 4)
+  {
+    __m128 l = magnitude4_sse2(left + 2 * i, vscale);
+    __m128 r = magnitude4_sse2(right + 2 * i, vscale);
+    _mm_storeu_ps(output + 2 * i, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(output + 2 * i + 4, _mm_unpackhi_ps(l, r));
+  }
+  magnitude_scalar(left + 2 * i, right + 2 * i, output + 2 * i, bins - i, scale);
+}
+
+PI_TARGET_SSE2 void magnitude_mono_sse2(const float* data, float* output, size_t bins, float scale)
+{
+  const __m128 vscale = _mm_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 4 <= bins; i += 4)
+    _mm_storeu_ps(output + i, magnitude4_sse2(data + 2 * i, vscale));
+  magnitude_mono_scalar(data + 2 * i, output + i, bins - i, scale);
+}
+
+// Four frames at a time, one per lane: transposing 4 channels of each frame
+// gives one vector per channel. "USED" is the number of channels mixed, the
+// lanes of channels beyond it are left out. The loads of the last frames
+// would read past the end of the input, returns where the scalar loop has to
+// take over.
+template<size_t USED>
+PI_TARGET_SSE2 size_t downmix4_sse2(const float* input, size_t channels, const float* coeffs, float* output, size_t frames)
+{
+  const size_t groups = (USED + 3) / 4;
+  __m128 left[USED];
+  __m128 right[USED];
+  for (size_t c = 0; c < USED; c++)
+  {
+    left[c] = _mm_set1_ps(coeffs[c]);
+    right[c] = _mm_set1_ps(coeffs[DOWNMIX_MAX_CHANNELS + c]);
+  }
+
+  size_t i = 0;
+  for (; i + 4 <= frames && (i + 3) * channels + 4 * groups <= frames * channels; i += 4)
+  {
+    const float* block = input + i * channels;
+    __m128 x[4 * groups];
+    for (size_t g = 0; g < groups; g++)
+    {
+      x[4 * g] = _mm_loadu_ps(block + 4 * g);
+      x[4 * g + 1] = _mm_loadu_ps(block + channels + 4 * g);
+      x[4 * g + 2] = _mm_loadu_ps(block + 2 * channels + 4 * g);
+      x[4 * g + 3] = _mm_loadu_ps(block + 3 * channels + 4 * g);
+      _MM_TRANSPOSE4_PS(x[4 * g], x[4 * g + 1], x[4 * g + 2], x[4 * g + 3]);
+    }
+
+    __m128 l = _mm_setzero_ps();
+    __m128 r = _mm_setzero_ps();
+    for (size_t c = 0; c < USED; c++)
+    {
+      l = _mm_add_ps(l, _mm_mul_ps(x[c], left[c]));
+      r = _mm_add_ps(r, _mm_mul_ps(x[c], right[c]));
+    }
+    _mm_storeu_ps(output + 2 * i, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(output + 2 * i + 4, _mm_unpackhi_ps(l, r));
+  }
+  return i;
+}
+
+PI_TARGET_SSE2 void downmix_sse2(const float* input, size_t channels, const float* coeffs, float* output, size_t frames)
+{
+  size_t i = 0;
+  switch (std::min(channels, DOWNMIX_MAX_CHANNELS))
+  {
+    case 1: i = downmix4_sse2<1>(input, channels, coeffs, output, frames); break;
+    case 2: i = downmix4_sse2<2>(input, channels, coeffs, output, frames); break;
+    case 3: i = downmix4_sse2<3>(input, channels, coeffs, output, frames); break;
+    case 4: i = downmix4_sse2<4>(input, channels, coeffs, output, frames); break;
+    case 5: i = downmix4_sse2<5>(input, channels, coeffs, output, frames); break;
+    case 6: i = downmix4_sse2<6>(input, channels, coeffs, output, frames); break;
+    case 7: i = downmix4_sse2<7>(input, channels, coeffs, output, frames); break;
+    case 8: i = downmix4_sse2<8>(input, channels, coeffs, output, frames); break;
+  }
+  downmix_scalar(input + i * channels, channels, coeffs, output + 2 * i, frames - i);
+}
+
+PI_TARGET_SSE2 float peak_sse2(const float* data, size_t count)
+{
+  const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 peak = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(data + i), mask));
+
+  peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+  peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 1, 1, 1)));
+  return std::max(_mm_cvtss_f32(peak), peak_scalar(data + i, count - i));
+}
+
+PI_TARGET_SSE2 void smooth_sse2(float* current, const float* target, size_t count, float rise, float fall)
+{
+  const __m128 vrise = _mm_set1_ps(rise);
+  const __m128 vfall = _mm_set1_ps(fall);
+  const __m128 zero = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 c = _mm_loadu_ps(current + i);
+    __m128 diff = _mm_sub_ps(_mm_loadu_ps(target + i), c);
+    __m128 up = _mm_cmpgt_ps(diff, zero);
+    __m128 coef = _mm_or_ps(_mm_and_ps(up, vrise), _mm_andnot_ps(up, vfall));
+    _mm_storeu_ps(current + i, _mm_add_ps(c, _mm_mul_ps(diff, coef)));
+  }
+  smooth_scalar(current + i, target + i, count - i, rise, fall);
+}
+
+/*
+ * AVX2
+ */
+PI_TARGET_AVX2 void deinterleave_avx2(const float* input, float* left, float* right, size_t frames)
+{
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8)
+  {
+    __m256 a = _mm256_loadu_ps(input + 2 * i);
+    __m256 b = _mm256_loadu_ps(input + 2 * i + 8);
+    // Shuffles work per 128 bit lane, so fix up the order of the 64 bit
+    // halves afterwards: [0 1 4 5 | 2 3 6 7] -> [0 1 2 3 | 4 5 6 7]
+    __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    l = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0)));
+    r = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm256_storeu_ps(left + i, l);
+    _mm256_storeu_ps(right + i, r);
+  }
+  deinterleave_sse2(input + 2 * i, left + i, right + i, frames - i);
+}
+
+PI_TARGET_AVX2 void multiply_avx2(const float* a, const float* b, float* output, size_t count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+  multiply_sse2(a + i, b + i, output + i, count - i);
+}
+
+PI_TARGET_AVX2 inline __m256 magnitude8_avx2(const float* data, __m256 scale)
+{
+  __m256 a = _mm256_loadu_ps(data);
+  __m256 b = _mm256_loadu_ps(data + 8);
+  a = _mm256_mul_ps(a, a);
+  b = _mm256_mul_ps(b, b);
+  // Lane order of the result is [0 1 4 5 | 2 3 6 7]
+  __m256 sum = _mm256_add_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+                             _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  return _mm256_mul_ps(_mm256_sqrt_ps(sum), scale);
+}
+
+PI_TARGET_AVX2 void magnitude_avx2(const float* left, const float* right, float* output, size_t bins, float scale)
+{
+  const __m256 vscale = _mm256_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 8 <= bins; i += 8)
+  {
+    __m256 l = magnitude8_avx2(left + 2 * i, vscale);
+    __m256 r = magnitude8_avx2(right + 2 * i, vscale);
+    // The per lane unpack undoes the lane order from above:
+    // lo = [L0 R0 L1 R1 | L2 R2 L3 R3], hi = [L4 R4 L5 R5 | L6 R6 L7 R7]
+    _mm256_storeu_ps(output + 2 * i, _mm256_unpacklo_ps(l, r));
+    _mm256_storeu_ps(output + 2 * i + 8, _mm256_unpackhi_ps(l, r));
+  }
+  magnitude_sse2(left + 2 * i, right + 2 * i, output + 2 * i, bins - i, scale);
+}
+
+PI_TARGET_AVX2 void magnitude_mono_avx2(const float* data, float* output, size_t bins, float scale)
+{
+  const __m256 vscale = _mm256_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 8 <= bins; i += 8)
+  {
+    __m256 m = magnitude8_avx2(data + 2 * i, vscale);
+    m = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(m), _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm256_storeu_ps(output + i, m);
+  }
+  magnitude_mono_sse2(data + 2 * i, output + i, bins - i, scale);
+}
+
+PI_TARGET_AVX2 float peak_avx2(const float* data, size_t count)
+{
+  const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 peak = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(data + i), mask));
+
+  __m128 half = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+  half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_max_ss(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 1, 1, 1)));
+  return std::max(_mm_cvtss_f32(half), peak_sse2(data + i, count - i));
+}
+
+PI_TARGET_AVX2 void smooth_avx2(float* current, const float* target, size_t count, float rise, float fall)
+{
+  const __m256 vrise = _mm256_set1_ps(rise);
+  const __m256 vfall = _mm256_set1_ps(fall);
+  const __m256 zero = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 c = _mm256_loadu_ps(current + i);
+    __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(target + i), c);
+    __m256 coef = _mm256_blendv_ps(vfall, vrise, _mm256_cmp_ps(diff, zero, _CMP_GT_OQ));
+    _mm256_storeu_ps(current + i, _mm256_add_ps(c, _mm256_mul_ps(diff, coef)));
+  }
+  smooth_sse2(current + i, target + i, count - i, rise, fall);
+}
+
+bool cpu_has_sse2()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+  return true;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[3] & (1 << 26)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2");
+#endif
+}
+
+bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  // AVX needs OSXSAVE and the OS saving the YMM registers
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif // PI_KERNELS_X86
+
+#if defined(PI_KERNELS_NEON)
+/*
+ * NEON
+ */
+#if defined(PI_KERNELS_NEON_PRAGMA)
+#pragma GCC push_options
+#pragma GCC target("fpu=neon")
+#endif
+
+inline float32x4_t sqrt_neon(float32x4_t x)
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+  return vsqrtq_f32(x);
+#else
+  // ARMv7 has no vector square root: x * 1/sqrt(x) with two Newton steps,
+  // masking out zeros which would otherwise turn into NaN.
+  float32x4_t e = vrsqrteq_f32(x);
+  e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+  e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+  uint32x4_t nonzero = vcgtq_f32(x, vdupq_n_f32(0.0f));
+  return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(x, e)), nonzero));
+#endif
+}
+
+void deinterleave_neon(const float* input, float* left, float* right, size_t frames)
+{
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4)
+  {
+    float32x4x2_t v = vld2q_f32(input + 2 * i);
+    vst1q_f32(left + i, v.val[0]);
+    vst1q_f32(right + i, v.val[1]);
+  }
+  deinterleave_scalar(input + 2 * i, left + i, right + i, frames - i);
+}
+
+void multiply_neon(const float* a, const float* b, float* output, size_t count)
+{
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    vst1q_f32(output + i, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+  multiply_scalar(a + i, b + i, output + i, count - i);
+}
+
+inline float32x4_t magnitude4_neon(const float* data, float32x4_t scale)
+{
+  float32x4x2_t v = vld2q_f32(data);
+  float32x4_t sum = vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1]);
+  return vmulq_f32(sqrt_neon(sum), scale);
+}
+
+void magnitude_neon(const float* left, const float* right, float* output, size_t bins, float scale)
+{
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  size_t i = 0;
+  for (; i + 4 <= bins; i += 4)
+  {
+    float32x4x2_t out;
+    out.val[0] = magnitude4_neon(left + 2 * i, vscale);
+    out.val[1] = magnitude4_neon(right + 2 * i, vscale);
+    vst2q_f32(output + 2 * i, out);
+  }
+  magnitude_scalar(left + 2 * i, right + 2 * i, output + 2 * i, bins - i, scale);
+}
+
+void magnitude_mono_neon(const float* data, float* output, size_t bins, float scale)
+{
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  size_t i = 0;
+  for (; i + 4 <= bins; i += 4)
+    vst1q_f32(output + i, magnitude4_neon(data + 2 * i, vscale));
+  magnitude_mono_scalar(data + 2 * i, output + i, bins - i, scale);
+}
+
+// See downmix4_sse2
+template<size_t USED>
+size_t downmix4_neon(const float* input, size_t channels, const float* coeffs, float* output, size_t frames)
+{
+  const size_t groups = (USED + 3) / 4;
+  float32x4_t left[USED];
+  float32x4_t right[USED];
+  for (size_t c = 0; c < USED; c++)
+  {
+    left[c] = vdupq_n_f32(coeffs[c]);
+    right[c] = vdupq_n_f32(coeffs[DOWNMIX_MAX_CHANNELS + c]);
+  }
+
+  size_t i = 0;
+  for (; i + 4 <= frames && (i + 3) * channels + 4 * groups <= frames * channels; i += 4)
+  {
+    const float* block = input + i * channels;
+    float32x4_t x[4 * groups];
+    for (size_t g = 0; g < groups; g++)
+    {
+      float32x4x2_t t01 = vtrnq_f32(vld1q_f32(block + 4 * g), vld1q_f32(block + channels + 4 * g));
+      float32x4x2_t t23 = vtrnq_f32(vld1q_f32(block + 2 * channels + 4 * g),
+                                    vld1q_f32(block + 3 * channels + 4 * g));
+      x[4 * g] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+      x[4 * g + 1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+      x[4 * g + 2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+      x[4 * g + 3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    }
+
+    float32x4x2_t lr;
+    lr.val[0] = vdupq_n_f32(0.0f);
+    lr.val[1] = vdupq_n_f32(0.0f);
+    for (size_t c = 0; c < USED; c++)
+    {
+      lr.val[0] = vmlaq_f32(lr.val[0], x[c], left[c]);
+      lr.val[1] = vmlaq_f32(lr.val[1], x[c], right[c]);
+    }
+    vst2q_f32(output + 2 * i, lr);
+  }
+  return i;
+}
+
+void downmix_neon(const float* input, size_t channels, const float* coeffs, float* output, size_t frames)
+{
+  size_t i = 0;
+  switch (std::min(channels, DOWNMIX_MAX_CHANNELS))
+  {
+    case 1: i = downmix4_neon<1>(input, channels, coeffs, output, frames); break;
+    case 2: i = downmix4_neon<2>(input, channels, coeffs, output, frames); break;
+    case 3: i = downmix4_neon<3>(input, channels, coeffs, output, frames); break;
+    case 4: i = downmix4_neon<4>(input, channels, coeffs, output, frames); break;
+    case 5: i = downmix4_neon<5>(input, channels, coeffs, output, frames); break;
+    case 6: i = downmix4_neon<6>(input, channels, coeffs, output, frames); break;
+    case 7: i = downmix4_neon<7>(input, channels, coeffs, output, frames); break;
+    case 8: i = downmix4_neon<8>(input, channels, coeffs, output, frames); break;
+  }
+  downmix_scalar(input + i * channels, channels, coeffs, output + 2 * i, frames - i);
+}
+
+float peak_neon(const float* data, size_t count)
+{
+  float32x4_t peak = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(data + i)));
+
+  float32x2_t half = vmax_f32(vget_low_f32(peak), vget_high_f32(peak));
+  half = vpmax_f32(half, half);
+  return std::max(vget_lane_f32(half, 0), peak_scalar(data + i, count - i));
+}
+
+void smooth_neon(float* current, const float* target, size_t count, float rise, float fall)
+{
+  const float32x4_t vrise = vdupq_n_f32(rise);
+  const float32x4_t vfall = vdupq_n_f32(fall);
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    float32x4_t c = vld1q_f32(current + i);
+    float32x4_t diff = vsubq_f32(vld1q_f32(target + i), c);
+    float32x4_t coef = vbslq_f32(vcgtq_f32(diff, zero), vrise, vfall);
+    vst1q_f32(current + i, vmlaq_f32(c, diff, coef));
+  }
+  smooth_scalar(current + i, target + i, count - i, rise, fall);
+}
+
+#if defined(PI_KERNELS_NEON_PRAGMA)
+#pragma GCC pop_options
+#endif
+
+bool cpu_has_neon()
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+  return true;
+#elif defined(__linux__)
+  return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+  return true;
+#endif
+}
+#endif // PI_KERNELS_NEON
+
+const sKernels scalar_kernels = {"scalar", deinterleave_scalar, multiply_scalar, magnitude_scalar,
+                                 magnitude_mono_scalar, downmix_scalar, peak_scalar,
+                                 smooth_scalar};
+#if defined(PI_KERNELS_X86)
+const sKernels sse2_kernels = {"SSE2", deinterleave_sse2, multiply_sse2, magnitude_sse2,
+                               magnitude_mono_sse2, downmix_sse2, peak_sse2, smooth_sse2};
+// Eight frames per step would need 8x8 transposes across the AVX2 lanes,
+// the downmix stays at four
+const sKernels avx2_kernels = {"AVX2", deinterleave_avx2, multiply_avx2, magnitude_avx2,
+                               magnitude_mono_avx2, downmix_sse2, peak_avx2, smooth_avx2};
+#endif
+#if defined(PI_KERNELS_NEON)
+const sKernels neon_kernels = {"NEON", deinterleave_neon, multiply_neon, magnitude_neon,
+                               magnitude_mono_neon, downmix_neon, peak_neon, smooth_neon};
+#endif
+
+const sKernels& detect_kernels()
+{
+#if defined(PI_KERNELS_X86)
+  if (cpu_has_avx2())
+    return avx2_kernels;
+  if (cpu_has_sse2())
+    return sse2_kernels;
+#elif defined(PI_KERNELS_NEON)
+  if (cpu_has_neon())
+    return neon_kernels;
+#endif
+  return scalar_kernels;
+}
+
+} // namespace
+
+const sKernels& get_kernels()
+{
+  static const sKernels& kernels = detect_kernels();
+  return kernels;
+}
+
+const sKernels& get_scalar_kernels()
+{
+  return scalar_kernels;
+}
@@ -0,0 +1,68 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+//! \brief Table of the inner loops used by the spectrum analysis.
+//!
+//! Every entry has a scalar reference implementation and, where the target
+//! allows it, SSE2/AVX2/NEON versions. The best table for the CPU we are
+//! running on is picked once at runtime, so a single binary serves everything
+//! from Atom-class x86 boxes to ARM sticks.
+//!
+//! None of the kernels require aligned pointers, but aligned buffers (see
+//! aligned.h) avoid split loads.
+struct sKernels
+{
+  //! Name used for logging
+  const char* name;
+
+  //! \brief Split interleaved stereo into two planar buffers.
+  //! \param input Interleaved data of 2*frames samples.
+  void (*deinterleave)(const float* input, float* left, float* right, size_t frames);
+
+  //! \brief output[i] = a[i] * b[i], output may alias a.
+  void (*multiply)(const float* a, const float* b, float* output, size_t count);
+
+  //! \brief Interleaved, scaled magnitudes of two complex spectra.
+  //! \param left Complex (re, im) pairs of the left channel.
+  //! \param right Complex (re, im) pairs of the right channel.
+  //! \param output 2*bins magnitudes, L/R interleaved.
+  void (*magnitude)(const float* left, const float* right, float* output, size_t bins, float scale);
+
+  //! \brief Scaled magnitudes of a single complex spectrum.
+  //! \param data Complex (re, im) pairs.
+  //! \param output bins magnitudes.
+  void (*magnitude_mono)(const float* data, float* output, size_t bins, float scale);
+
+  //! \brief Downmix interleaved multichannel audio to interleaved stereo.
+  //! \param input Interleaved data of frames*channels samples. Only the first
+  //!              8 channels are taken into account.
+  //! \param channels Number of input channels.
+  //! \param coeffs 16 gains: 8 for the left output followed by 8 for the
+  //!               right output, zero for unused channels.
+  //! \param output Interleaved stereo data of 2*frames samples.
+  void (*downmix)(const float* input, size_t channels, const float* coeffs, float* output, size_t frames);
+
+  //! \brief Largest absolute value of count samples.
+  float (*peak)(const float* data, size_t count);
+
+  //! \brief Move values towards their targets, branch-free:
+  //!        current += (target - current) * (target > current ? rise : fall)
+  void (*smooth)(float* current, const float* target, size_t count, float rise, float fall);
+};
+
+//! \brief Maximum number of input channels supported by sKernels::downmix.
+constexpr size_t DOWNMIX_MAX_CHANNELS = 8;
+
+//! \brief The kernels best suited for this CPU, detected on first use.
+const sKernels& get_kernels();
+
+//! \brief The portable scalar reference kernels.
+const sKernels& get_scalar_kernels();
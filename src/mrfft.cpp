@@ -7,15 +7,33 @@
 
 #include "mrfft.h"
 
+#include <cstring>
+
 #if defined(TARGET_WINDOWS) && !defined(_USE_MATH_DEFINES)
 #define _USE_MATH_DEFINES
 #endif
 #include <math.h>
 
-MRFFT::MRFFT(int size, bool windowed) :
-    m_size(size), m_windowed(windowed)
+MRFFT::MRFFT(int size, Window window, Mode mode) :
+    m_size(size), m_window(window), m_mode(mode), m_scale(2.0f/size),
+    m_loutput(size/2+1), m_routput(size/2+1),
+    m_output(size),
+    m_kernels(get_kernels())
 {
-    m_cfg = kiss_fftr_alloc(m_size,0,nullptr,nullptr);
+    if (m_mode == Mode::Packed)
+    {
+        m_cfgc = kiss_fft_alloc(m_size,0,nullptr,nullptr);
+        m_pinput.resize(m_size);
+        m_poutput.resize(m_size);
+    }
+    else
+    {
+        m_cfg = kiss_fftr_alloc(m_size,0,nullptr,nullptr);
+        m_linput.resize(m_size);
+        if (m_mode == Mode::Separate)
+            m_rinput.resize(m_size);
+    }
+    build_window();
 }
 
 MRFFT::~MRFFT()
@@ -25,47 +43,137 @@ MRFFT::~MRFFT()
     // to SIMD (which might be used during kiss_fftr_alloc
     //in the C'tor).
     KISS_FFT_FREE(m_cfg);
+    KISS_FFT_FREE(m_cfgc);
 }
 
-void MRFFT::calc(const float* input, float* output)
+const float* MRFFT::calc(const float* input)
 {
-    // temporary buffers
-    std::vector<kiss_fft_scalar> linput(m_size), rinput(m_size);
-    std::vector<kiss_fft_cpx> loutput(m_size), routput(m_size);
+    calc(input, m_output.data());
+    return m_output.data();
+}
 
-    for (size_t i=0;i<m_size;++i)
+void MRFFT::calc(const float* input, float* output)
+{
+    if (m_mode == Mode::Mono)
     {
-        linput[i] = input[2*i];
-        rinput[i] = input[2*i+1];
+        calc_mono(input);
+        m_kernels.magnitude_mono(reinterpret_cast<const float*>(m_loutput.data()),
+                                 output, m_size/2, m_scale);
+        return;
     }
 
-    if (m_windowed)
+    if (m_mode == Mode::Packed)
+        calc_packed(input);
+    else
+        calc_separate(input);
+
+    // interleave while taking magnitudes and normalizing
+    m_kernels.magnitude(reinterpret_cast<const float*>(m_loutput.data()),
+                        reinterpret_cast<const float*>(m_routput.data()),
+                        output, m_size/2, m_scale);
+}
+
+void MRFFT::calc_separate(const float* input)
+{
+    m_kernels.deinterleave(input, m_linput.data(), m_rinput.data(), m_size);
+
+    if (m_window != Window::None)
     {
-        hann(linput);
-        hann(rinput);
+        apply_window(m_linput.data());
+        apply_window(m_rinput.data());
     }
 
     // transform channels
-    kiss_fftr(m_cfg, &linput[0], &loutput[0]);
-    kiss_fftr(m_cfg, &rinput[0], &routput[0]);
+    kiss_fftr(m_cfg, m_linput.data(), m_loutput.data());
+    kiss_fftr(m_cfg, m_rinput.data(), m_routput.data());
+}
 
-    auto&& filter = [&](kiss_fft_cpx& data)
-    {
-        return sqrt(data.r*data.r+data.i*data.i) * 2.0/m_size * (m_windowed?sqrt(8.0/3.0):1.0);
-    };
+void MRFFT::calc_mono(const float* input)
+{
+    if (m_window != Window::None)
+        m_kernels.multiply(input, m_windowTable.data(), m_linput.data(), m_size);
+    else
+        memcpy(m_linput.data(), input, m_size*sizeof(float));
 
-    // interleave while taking magnitudes and normalizing
-    for (size_t i=0;i<m_size/2;++i)
+    kiss_fftr(m_cfg, m_linput.data(), m_loutput.data());
+}
+
+void MRFFT::calc_packed(const float* input)
+{
+    // Interleaved stereo already has the layout of a complex buffer with left
+    // as the real and right as the imaginary part.
+    float* packed = reinterpret_cast<float*>(m_pinput.data());
+    if (m_window != Window::None)
+        m_kernels.multiply(input, m_windowTable.data(), packed, 2*m_size);
+    else
+        memcpy(packed, input, 2*m_size*sizeof(float));
+
+    kiss_fft(m_cfgc, m_pinput.data(), m_poutput.data());
+
+    // Separate the spectra:
+    //   L[k] = (Z[k] + conj(Z[N-k])) / 2
+    //   R[k] = (Z[k] - conj(Z[N-k])) / 2i
+    for (size_t k=0;k<=m_size/2;++k)
     {
-        output[2*i] = filter(loutput[i]);
-        output[2*i+1] = filter(routput[i]);
+        const kiss_fft_cpx& z = m_poutput[k];
+        const kiss_fft_cpx& zn = m_poutput[k ? m_size-k : 0];
+
+        m_loutput[k].r = 0.5f * (z.r + zn.r);
+        m_loutput[k].i = 0.5f * (z.i - zn.i);
+        m_routput[k].r = 0.5f * (z.i + zn.i);
+        m_routput[k].i = 0.5f * (zn.r - z.r);
     }
 }
 
-#include <iostream>
+void MRFFT::build_window()
+{
+    if (m_window == Window::None)
+        return;
+
+    // The packed mode windows the interleaved input directly, so it gets
+    // every coefficient twice.
+    const size_t stride = m_mode == Mode::Packed ? 2 : 1;
+    m_windowTable.resize(stride*m_size);
+    m_scale = make_window(m_window, m_size, m_windowTable.data(), stride);
+}
+
+float MRFFT::make_window(Window window, size_t size, float* table, size_t stride)
+{
+    // Cosine-sum coefficients a0..a4 of the supported windows.
+    double a[5] = {};
+    switch (window)
+    {
+    case Window::Hann:
+        a[0] = 0.5; a[1] = 0.5;
+        break;
+    case Window::BlackmanHarris:
+        a[0] = 0.35875; a[1] = 0.48829; a[2] = 0.14128; a[3] = 0.01168;
+        break;
+    case Window::FlatTop:
+        a[0] = 0.21557895; a[1] = 0.41663158; a[2] = 0.277263158;
+        a[3] = 0.083578947; a[4] = 0.006947368;
+        break;
+    default:
+        a[0] = 1.0;
+        break;
+    }
+
+    double power = 0.0;
+    for (size_t i=0;i<size;++i)
+    {
+        double x = 2*M_PI*i/(size-1);
+        double w = a[0] - a[1]*cos(x) + a[2]*cos(2*x) - a[3]*cos(3*x) + a[4]*cos(4*x);
+        for (size_t j=0;j<stride;++j)
+            table[stride*i+j] = static_cast<float>(w);
+        power += w*w;
+    }
+
+    // Correct for the energy removed by the window (sqrt(8/3) for Hann) so the
+    // magnitudes stay comparable between window functions.
+    return static_cast<float>(2.0/size * sqrt(size/power));
+}
 
-void MRFFT::hann(std::vector<kiss_fft_scalar>& data)
+void MRFFT::apply_window(kiss_fft_scalar* data) const
 {
-    for (size_t i=0;i<data.size();++i)
-        data[i] *= 0.5*(1.0+cos(2*M_PI*i/(data.size()-1)));
+    m_kernels.multiply(data, m_windowTable.data(), data, m_size);
 }
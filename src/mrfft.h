@@ -7,31 +7,112 @@
 
 #pragma once
 
+#include "aligned.h"
+#include "kernels.h"
 #include "kiss_fftr.h"
-#include <vector>
 
-//! \brief Class performing a RFFT of interleaved stereo data.
+//! \brief Class performing a RFFT of interleaved stereo or mono data.
+//!
+//! In Mode::Packed both channels go through a single complex FFT, left as the
+//! real and right as the imaginary part, and are separated afterwards using
+//! the conjugate symmetry of real input. This halves the transform cost
+//! compared to Mode::Separate, which runs one RFFT per channel.
+//!
+//! All scratch memory and the window table are allocated together with the
+//! plan, so calc() never touches the heap.
 class MRFFT
 {
 public:
+    //! \brief Window functions which can be applied before the transform.
+    enum class Window
+    {
+        None,
+        Hann,
+        BlackmanHarris,
+        FlatTop
+    };
+
+    //! \brief How the two channels are transformed.
+    enum class Mode
+    {
+        Separate,   //!< One real FFT per channel.
+        Packed,     //!< One complex FFT for both channels.
+        Mono        //!< One real FFT of a single channel.
+    };
+
     //! \brief The constructor creates a RFFT plan.
     //! \brief size Length of time data for a single channel.
-    //! \brief windowed Whether or not to apply a Hann window to data.
-    MRFFT(int size, bool windowed=false);
+    //! \brief window Window function to apply to data.
+    //! \brief mode How the channels are transformed.
+    MRFFT(int size, Window window=Window::None, Mode mode=Mode::Separate);
 
     //! \brief Free the RFFT plan
     ~MRFFT();
 
+    MRFFT(const MRFFT&) = delete;
+    MRFFT& operator=(const MRFFT&) = delete;
+
     //! \brief Calculate FFTs
-    //! \param input Input data of size 2*m_size
-    //! \param output Output data of size m_size.
+    //! \param input Input data of size channels()*m_size
+    //! \param output Output data of size channels()*m_size/2.
     void calc(const float* input, float* output);
+
+    //! \brief Calculate FFTs into the internal output buffer
+    //! \param input Input data of size channels()*m_size
+    //! \return Output data of size channels()*m_size/2, valid until the next call.
+    const float* calc(const float* input);
+
+    //! \brief Number of interleaved channels in input and output.
+    size_t channels() const { return m_mode == Mode::Mono ? 1 : 2; }
+
+    //! \brief Length of time data for a single channel.
+    size_t size() const { return m_size; }
+
+    //! \brief The window function used by this plan.
+    Window window() const { return m_window; }
+
+    //! \brief The transform mode used by this plan.
+    Mode mode() const { return m_mode; }
+
+    //! \brief Compute the coefficients of a window function.
+    //! \param window Window function to compute.
+    //! \param size Number of coefficients.
+    //! \param table Receives size*stride coefficients.
+    //! \param stride Number of times each coefficient is repeated.
+    //! \return Magnitude normalization including the window correction.
+    static float make_window(Window window, size_t size, float* table, size_t stride=1);
 protected:
-    //! \brief Apply a Hann window to a buffer.
-    //! \param data Vector with data to apply window to.
-    static void hann(std::vector<kiss_fft_scalar>& data);
+    //! \brief Fill m_windowTable and m_scale for the selected window.
+    void build_window();
+
+    //! \brief Multiply a buffer with the precomputed window table.
+    //! \param data Buffer of m_size samples to apply the window to.
+    void apply_window(kiss_fft_scalar* data) const;
+
+    //! \brief Transform both channels with one RFFT each.
+    void calc_separate(const float* input);
+
+    //! \brief Transform both channels with a single complex FFT.
+    void calc_packed(const float* input);
+
+    //! \brief Transform a single channel.
+    void calc_mono(const float* input);
 
     size_t m_size;           //!< Size for a single channel.
-    bool m_windowed;         //!< Whether or not a Hann window is applied.
-    kiss_fftr_cfg m_cfg;     //!< FFT plan
+    Window m_window;         //!< Window function applied to data.
+    Mode m_mode;             //!< How the channels are transformed.
+    float m_scale;           //!< Normalization including window correction.
+    kiss_fftr_cfg m_cfg = nullptr;    //!< RFFT plan (Mode::Separate, Mode::Mono)
+    kiss_fft_cfg m_cfgc = nullptr;    //!< Complex FFT plan (Mode::Packed)
+
+    aligned_vector<float> m_windowTable;       //!< Window coefficients (interleaved in Mode::Packed)
+    aligned_vector<kiss_fft_scalar> m_linput;  //!< De-interleaved left (or mono) channel
+    aligned_vector<kiss_fft_scalar> m_rinput;  //!< De-interleaved right channel
+    aligned_vector<kiss_fft_cpx> m_loutput;    //!< Left channel spectrum
+    aligned_vector<kiss_fft_cpx> m_routput;    //!< Right channel spectrum
+    aligned_vector<kiss_fft_cpx> m_pinput;     //!< Packed L/R time data
+    aligned_vector<kiss_fft_cpx> m_poutput;    //!< Packed L/R spectrum
+    aligned_vector<float> m_output;            //!< Interleaved magnitudes
+
+    const sKernels& m_kernels;                 //!< SIMD kernels for this CPU
 };
@@ -7,6 +7,7 @@
  */
 
 #include "pictureit.h"
+#include "glversion.h"
 
 #include "mrfft.h"
 #define STB_IMAGE_IMPLEMENTATION
@@ -16,11 +17,38 @@
 #include "stb_image.h"
 
 #include <algorithm>
+#include <cmath>
 #include <random>
 
 namespace
 {
 const std::string img_filter = ".jpg|.jpeg|.png";
+
+// What the governor's quality levels change, see "apply_quality"
+const int QUALITY_LEVELS = 5;
+const char* const QUALITY_NAMES[QUALITY_LEVELS] = {
+  "full quality",
+  "half resolution background",
+  "no strip behind the spectrum",
+  "half the bars",
+  "analysing every other hop",
+};
+
+// Whether an image loaded as RGBA has no (partly) transparent pixel
+bool is_opaque(const unsigned char* rgba, int width, int height, int channels)
+{
+  // Grey or RGB sources get an alpha of 255 everywhere
+  if (channels == 1 || channels == 3)
+    return true;
+
+  const size_t pixels = static_cast<size_t>(width) * height;
+  for (size_t i = 0; i < pixels; i++)
+  {
+    if (rgba[4 * i + 3] != 255)
+      return false;
+  }
+  return true;
+}
 }
 
 CVisPictureIt::CVisPictureIt()
@@ -33,6 +61,8 @@ CVisPictureIt::CVisPictureIt()
 
 CVisPictureIt::~CVisPictureIt()
 {
+  stop_analysis();
+
   if (m_dataLoader != nullptr)
   {
     if (m_dataLoader->joinable())
@@ -70,14 +100,21 @@ ADDON_STATUS CVisPictureIt::Create()
   m_updateByInterval = kodi::addon::GetSettingBoolean("update_by_interval");
   m_imgUpdateInterval = kodi::addon::GetSettingInt("img_update_interval");
   m_fadeTimeMs = kodi::addon::GetSettingInt("fade_time_ms");
+  m_frameBudgetMs = kodi::addon::GetSettingInt("frame_budget_ms");
   m_visEnabled = kodi::addon::GetSettingBoolean("vis_enabled");
   m_visBgEnabled = kodi::addon::GetSettingBoolean("vis_bg_enabled");
 
   m_visWidth = kodi::addon::GetSettingInt("vis_half_width");
   m_visWidth = m_visWidth * 1.0f / 100;
 
-  m_visAnimationSpeed = kodi::addon::GetSettingInt("vis_animation_speed");
-  m_visAnimationSpeed = m_visAnimationSpeed * 0.005f / 100;
+  m_visAttackMs = kodi::addon::GetSettingInt("vis_attack_ms");
+  m_visReleaseMs = kodi::addon::GetSettingInt("vis_release_ms");
+  m_visBarCount = kodi::addon::GetSettingInt("vis_bar_count");
+  m_barRendererSetting = static_cast<BarRenderer>(kodi::addon::GetSettingInt("vis_bar_renderer"));
+
+  m_fftWindow = static_cast<MRFFT::Window>(kodi::addon::GetSettingInt("vis_fft_window") + 1);
+  m_fftSize = kodi::addon::GetSettingInt("vis_fft_size");
+  m_fftHop = m_fftSize * (100 - kodi::addon::GetSettingInt("vis_fft_overlap")) / 100;
 
   float scale[] = {1.0, 0.98, 0.96, 0.94, 0.92, 0.90, 0.88, 0.86, 0.84, 0.82, 0.80};
   m_visBottomEdge = scale[kodi::addon::GetSettingInt("vis_bottom_edge")];
@@ -129,21 +166,61 @@ bool CVisPictureIt::RandomPreset()
 bool CVisPictureIt::Start(int iChannels, int iSamplesPerSec,
                           int iBitsPerSample, const std::string& szSongName)
 {
+  // AudioData always hands us floats, so "iBitsPerSample" only tells us about
+  // the source and doesn't change the analysis.
+  kodi::Log(ADDON_LOG_DEBUG, "Starting with %i channels, %i Hz, %i bits", iChannels, iSamplesPerSec, iBitsPerSample);
+
+  // Audio may still be flowing from an earlier start, keep AudioData away
+  // from the ring and the analyser while they get reconfigured
+  block_audio_data();
+
+  if (iChannels > 0)
+    m_channels = iChannels;
+  if (iSamplesPerSec > 0)
+    m_sampleRate = iSamplesPerSec;
+
   if (!m_shadersLoaded)
   {
     std::string fraqShader = kodi::addon::GetAddonPath("resources/shaders/" GL_TYPE_STRING "/frag.glsl");
     std::string vertShader = kodi::addon::GetAddonPath("resources/shaders/" GL_TYPE_STRING "/vert.glsl");
-    if (!LoadShaderFiles(vertShader, fraqShader) || !CompileAndLink())
+    if (!m_texturedShader.load(vertShader, fraqShader, CQuadShader::Variant::Textured) ||
+        !m_crossfadeShader.load(vertShader, fraqShader, CQuadShader::Variant::Crossfade) ||
+        !m_solidShader.load(vertShader, fraqShader, CQuadShader::Variant::Solid))
       return false;
     m_shadersLoaded = true;
   }
 
-  glGenBuffers(1, &m_vertexVBO);
-  glGenBuffers(1, &m_indexVBO);
+  // Per frame at most two images, the strip behind the spectrum and (when
+  // uploading them) the vertices of all bars
+  m_vertexStream.create(sizeof(sLight) * (3 * 4 + 8 * m_visBarCount), sizeof(sLight));
+  setup_vertex_layout();
+#if defined(HAS_GL)
+  m_hasBaseVertex = gl_version_at_least(3, 2);
+#endif
+
+  kodi::Log(ADDON_LOG_DEBUG, "Using %s spectrum kernels", get_kernels().name);
+  kodi::Log(ADDON_LOG_DEBUG, "Streaming vertices with %s", m_vertexStream.mode_name());
+
+  start_analysis();
+  select_bar_renderer();
+  m_visBarsDrawn = m_visBarCount;
+  build_bars();
+
+  // Every start begins at full quality
+  m_gpuTimer.create();
+  m_governor.configure(m_frameBudgetMs, QUALITY_LEVELS - 1);
+  apply_quality();
+  if (m_governor.enabled())
+    kodi::Log(ADDON_LOG_DEBUG, "Frame time budget %i ms, measuring %s", m_frameBudgetMs,
+              m_gpuTimer.available() ? "CPU and GPU time" : "CPU time only");
 
   if (!m_dataLoader)
     m_dataLoader = std::make_shared<std::thread>(&CVisPictureIt::load_data, this, m_presetsRootDir);
 
+  // The update interval counts from here
+  m_timeline.advance();
+  m_timeline.schedule(CTimeline::Event::NextImage, m_imgUpdateInterval * 1000.0f);
+
   m_initialized = true;
 
   return true;
@@ -154,12 +231,17 @@ void CVisPictureIt::Stop()
   if (!m_initialized)
     return;
 
-  m_initialized = false;
+  block_audio_data();
 
-  glDeleteBuffers(1, &m_vertexVBO);
-  m_vertexVBO = 0;
-  glDeleteBuffers(1, &m_indexVBO);
-  m_indexVBO = 0;
+  stop_analysis();
+
+  m_vertexStream.destroy();
+  m_gpuTimer.destroy();
+  m_background.destroy();
+  m_backgroundDirty = true;
+  release_vertex_layout();
+  m_barShader.release();
+  m_instancedBarShader.release();
 }
 
 bool CVisPictureIt::UpdateTrack(const kodi::addon::VisualizationTrack& track)
@@ -176,10 +258,12 @@ void CVisPictureIt::Render()
   if (!m_initialized)
     return;
 
-  start_render();
+  // Everything below works with this one sample of the clock
+  m_timeline.advance();
+  const CTimeline::Clock::time_point frameStart = m_timeline.now();
 
   // reached next update-intervall
-  if (m_updateByInterval && time(0) >= (m_imgLastUpdated + m_imgUpdateInterval))
+  if (m_updateByInterval && m_timeline.due(CTimeline::Event::NextImage))
   {
     m_updateImg = true;
   }
@@ -188,7 +272,7 @@ void CVisPictureIt::Render()
   {
     kodi::Log(ADDON_LOG_DEBUG, "Requesting new image...");
     m_updateImg = false;
-    m_imgLastUpdated = time(0);
+    m_timeline.schedule(CTimeline::Event::NextImage, m_imgUpdateInterval * 1000.0f);
 
     if (m_imgTextureIds[2] != 0)
     {
@@ -227,141 +311,248 @@ void CVisPictureIt::Render()
       m_imgData = nullptr;
 
       m_imgTextureIds[1] = texture[0];
+      m_imgTextureOpaque[1] = m_imgOpaque;
     }
 
-    m_fadeCurrent = 0.0f;
-    m_fadeOffsetMs = static_cast<long>(std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count() * 1000.0) % m_fadeTimeMs;
+    m_timeline.start_fade(m_fadeTimeMs);
   }
 
-  // If we are within a crossfade, fade out the current image
-  if (m_fadeCurrent < 1.0f)
-  {
-    draw_image(m_imgTextureIds[0], 1.0f - m_fadeCurrent);
-  }
-  else
+  // Move the crossfade along first, so both images use the same progress
+  const float fade = m_timeline.fade_progress();
+  if (m_timeline.fade_finished())
   {
-    draw_image(m_imgTextureIds[0], 1.0f);
+    // Recycle the current image.
+    m_imgTextureIds[2] = m_imgTextureIds[0];
+    m_imgTextureOpaque[2] = m_imgTextureOpaque[0];
+
+    // Display the next image from now on.
+    m_imgTextureIds[0] = m_imgTextureIds[1];
+    m_imgTextureOpaque[0] = m_imgTextureOpaque[1];
+    m_backgroundDirty = true;
   }
 
-  if (m_fadeOffsetMs && m_fadeCurrent < 1.0f)
+  // Within a crossfade: mix both images in one pass if there are two,
+  // otherwise fade in the first one
+  const bool fading = m_timeline.fading();
+  const bool crossfade = fading && m_imgTextureIds[0] && m_imgTextureIds[1];
+  const bool fadeIn = fading && !m_imgTextureIds[0];
+
+  // Outside fades the image and the strip behind the spectrum stay the same
+  // from frame to frame, so draw them once into "m_background" and reuse
+  // that as a single quad. Without the strip the image alone is cached, so
+  // a smaller "m_background" still saves fill rate.
+  const bool strip = m_visEnabled && m_visBgEnabled && !m_stripDropped;
+  const bool cached = !fading && update_background_target();
+
+  if (cached)
   {
-    m_fadeCurrent = ((float) ((static_cast<long>(std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count() * 1000.0) - m_fadeOffsetMs) % m_fadeTimeMs) / m_fadeTimeMs);
-    if (m_fadeCurrent < m_fadeLast)
+    // The cached background is opaque and covers the whole screen
+    start_render(false);
+    if (m_backgroundDirty)
     {
-      m_fadeLast = 0.0f;
-      m_fadeCurrent = 1.0f;
-      m_fadeOffsetMs = 0;
+      m_background.bind();
+      glClear(GL_COLOR_BUFFER_BIT);
+      draw_image(m_imgTextureIds[0], 1.0f, m_imgTextureOpaque[0]);
+      if (strip)
+        draw_strip();
+      m_background.unbind();
+      m_backgroundDirty = false;
+    }
+    draw_background();
+  }
+  else
+  {
+    // Opaque images cover the whole screen, so whatever was there before
+    // needs neither clearing nor blending
+    bool opaque;
+    if (crossfade)
+      opaque = m_imgTextureOpaque[0] && m_imgTextureOpaque[1];
+    else if (fadeIn)
+      opaque = false;
+    else
+      opaque = m_imgTextureIds[0] && m_imgTextureOpaque[0];
 
-      // Recycle the current image.
-      m_imgTextureIds[2] = m_imgTextureIds[0];
+    start_render(!opaque);
 
-      // Display the next image from now on.
-      m_imgTextureIds[0] = m_imgTextureIds[1];
-    }
+    if (crossfade)
+      draw_crossfade(m_imgTextureIds[0], m_imgTextureIds[1], fade, opaque);
+    else if (fadeIn)
+      draw_image(m_imgTextureIds[1], fade, false);
     else
-    {
-      m_fadeLast = m_fadeCurrent;
-    }
+      draw_image(m_imgTextureIds[0], 1.0f, m_imgTextureOpaque[0]);
 
-    draw_image(m_imgTextureIds[1], m_fadeCurrent);
+    if (strip)
+      draw_strip();
   }
 
   if (m_visEnabled)
   {
-    m_textureUsed = false;
-    EnableShader();
-
-    // If set to "true" we draw a transparent background which goes
-    // behind the spectrum.
-    if (m_visBgEnabled)
+    // Grab the newest complete frame from AudioData
+    m_barFrames.update();
+
+    // Exponential smoothing: after "attack"/"release" ms a bar has covered
+    // ~63% of the distance to its target, whatever the frame rate is.
+    const float frameMs = m_timeline.frame_ms();
+    m_visAttackCoef = 1.0f - std::exp(-frameMs / std::max(m_visAttackMs, 1.0f));
+    m_visReleaseCoef = 1.0f - std::exp(-frameMs / std::max(m_visReleaseMs, 1.0f));
+
+    // Update all bars in one go before anything gets drawn
+    get_kernels().smooth(m_cvisBarHeights.data(), m_barFrames.read_buffer().heights.data(),
+                         m_visBarCount, m_visAttackCoef, m_visReleaseCoef);
+
+    // With fewer bars drawn, each one shows the louder of two neighbours
+    const GLfloat* heights = m_cvisBarHeights.data();
+    if (m_visBarsDrawn < m_visBarCount)
     {
-      sLight framedTextures[4];
-      framedTextures[0].color = framedTextures[1].color = framedTextures[2].color = framedTextures[3].color = sColor(0.0f, 0.0f, 0.0f, 0.7f);
-      framedTextures[0].vertex = sPosition(1.0f, (m_visBottomEdge - m_visBarMaxHeight) - (1.0f - m_visBottomEdge));
-      framedTextures[1].vertex = sPosition(-1.0f,(m_visBottomEdge - m_visBarMaxHeight) - (1.0f - m_visBottomEdge));
-      framedTextures[2].vertex = sPosition(-1.0f, 1.0f);
-      framedTextures[3].vertex = sPosition( 1.0f, 1.0f);
-
-      glEnable(GL_BLEND);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(sLight)*4, framedTextures, GL_STATIC_DRAW);
-      glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, 0);
-      glDisable(GL_BLEND);
+      for (int i = 0; i < m_visBarsDrawn; i++)
+        m_mergedBarHeights[i] = std::max(m_cvisBarHeights[2 * i],
+                                         m_cvisBarHeights[std::min(2 * i + 1, m_visBarCount - 1)]);
+      heights = m_mergedBarHeights.data();
     }
 
-    // Finally we draw all of our bars
-    // The mirrored bars will get drawn within the "draw_bars".
-    // This needs to be done to ensure the exact same height-value for both
-    // the left and the (mirrored) right bar
-    GLfloat x1, x2;
-    float bar_width = m_visWidth / m_visBarCount;
-    for (int i = 1; i <= m_visBarCount; i++)
-    {
-      // calculate position
-      x1 = (m_visWidth * -1) + (i * bar_width) - bar_width;
-      x2 = (m_visWidth * -1) + (i * bar_width);
-
-      // "add" a gap (which is 1/4 of the initial bar_width)
-      // to both the left and right side of the bar
-      x1 = x1 + (bar_width / 4);
-      x2 = x2 - (bar_width / 4);
-
-      draw_bars((i-1), x1, x2);
-    }
-
-    DisableShader();
+    // Finally we draw all of our bars (and their mirrored counterparts) in
+    // one go
+    draw_bars(heights);
   }
 
   finish_render();
+  update_quality(frameStart);
 }
 
 void CVisPictureIt::AudioData(const float* pAudioData, size_t iAudioDataLength)
 {
-  if (!m_visEnabled || !m_initialized)
+  if (!m_visEnabled)
     return;
 
-  size_t iFreqDataLength = iAudioDataLength / 2;
-  iFreqDataLength -= iFreqDataLength % 2;
+  // Announce the call before checking "m_initialized", see "block_audio_data"
+  m_audioDataCalls++;
+  if (m_initialized)
+  {
+    // Nothing but a copy happens on Kodi's audio thread, the analysis thread
+    // picks the samples up from here. If it falls behind we rather drop
+    // samples than stall the player.
+    size_t written = m_samples.push(pAudioData, iAudioDataLength, m_inputChannels);
+    if (written < iAudioDataLength)
+      m_samplesDropped.fetch_add(iAudioDataLength - written, std::memory_order_relaxed);
+
+    m_lastAudioDataTime.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                              std::memory_order_release);
+  }
+  m_audioDataCalls--;
+}
+
+void CVisPictureIt::block_audio_data()
+{
+  /**
+   * Clear "m_initialized" and wait for AudioData calls which may have seen
+   * it set. Both sides use sequentially consistent operations, so a call
+   * either gets counted before we look at the counter or sees the flag
+   * cleared. AudioData itself never waits.
+   */
+  m_initialized = false;
+  while (m_audioDataCalls != 0)
+    std::this_thread::yield();
+}
+
+void CVisPictureIt::start_analysis()
+{
+  stop_analysis();
+
+  // Everything sized by the bar count is (re)allocated here, before the
+  // analysis thread and Render get to see it
+  sBarFrame empty;
+  empty.heights.assign(m_visBarCount, m_visBarMinHeight);
+  m_barFrames.reset(empty);
+  // Padded to whole vec4s for "CBarShader"
+  m_cvisBarHeights.assign((m_visBarCount + 3) & ~3, m_visBarMinHeight);
+  m_mergedBarHeights.assign(m_cvisBarHeights.size(), m_visBarMinHeight);
+
+  // The analyser and the sample ring are sized here, so neither AudioData nor
+  // the analysis thread ever allocate
+  m_analyser.configure(m_fftSize, m_fftHop, m_sampleRate, m_channels, m_visBarCount, m_fftWindow);
+  kodi::Log(ADDON_LOG_DEBUG, "Using %s spectrum engine", m_analyser.engine_name());
+
+  // Half a second of audio is plenty to ride out a stalled analysis thread
+  m_inputChannels = m_analyser.input_channels();
+  m_samples.resize(m_inputChannels * std::max(m_sampleRate / 2, static_cast<int>(m_fftSize)));
+  m_analysisBuffer.assign(m_samples.capacity(), 0.0f);
+
+  m_samplesDropped = 0;
+  m_latencyCount = 0;
+  m_latencySumUs = 0;
+  m_latencyMaxUs = 0;
+  m_lastAudioDataTime = 0;
+
+  m_analysisActive = true;
+  m_analysisThread = std::make_shared<std::thread>(&CVisPictureIt::analysis_thread, this);
+}
 
-  float* freq_data = new float[iFreqDataLength];
+void CVisPictureIt::stop_analysis()
+{
+  if (m_analysisThread == nullptr)
+    return;
 
-  // This part is essentially the same as what Kodi would do if we'd set "pInfo->bWantsFreq = true" (in the GetInfo methode)
-  // However, even though Kodi can do windowing (Hann window) they set the flag for it to "false" (hardcoded).
-  // So I just copied the "rfft.h" and "rfft.cpp", renamed the classe to "MRFFT" (otherwise we'd use the original) and set
-  // the flag to "true".
-  // Further this gives us the ability to change the response if needed (They return the magnitude per default I believe)
-  if (m_prevFreqDataLength != iFreqDataLength || ! m_tranform)
+  m_analysisActive = false;
+  if (m_analysisThread->joinable())
   {
-    m_tranform.reset(new MRFFT(iFreqDataLength, true));
-    m_prevFreqDataLength = iFreqDataLength;
+    m_analysisThread->join();
   }
+  m_analysisThread = nullptr;
+
+  const uint64_t count = m_latencyCount;
+  kodi::Log(ADDON_LOG_DEBUG, "Spectrum: %llu hops analysed, %llu skipped as silent, %llu samples dropped",
+            static_cast<unsigned long long>(m_analyser.analysed_count()),
+            static_cast<unsigned long long>(m_analyser.skipped_count()),
+            static_cast<unsigned long long>(m_samplesDropped.load()));
+  kodi::Log(ADDON_LOG_DEBUG, "Spectrum: AudioData to publish latency avg %llu us, max %llu us",
+            static_cast<unsigned long long>(count ? m_latencySumUs / count : 0),
+            static_cast<unsigned long long>(m_latencyMaxUs.load()));
+}
 
-  m_tranform->calc(pAudioData, freq_data);
+void CVisPictureIt::analysis_thread()
+{
+  // Poll at a quarter of the hop duration, which keeps the added latency well
+  // below one hop without spinning
+  const int sleepMs = std::min(10, std::max(1, static_cast<int>(m_fftHop * 250 / m_sampleRate)));
 
-  // Now that we have our values (as I said, the magnitude I guess) we just display them without a whole
-  // lot of modification.
-  // This is the part where the pre-processing should happen so we get a nice spectrum
-  for (int i = 0; i < m_visBarCount; i++)
+  while (m_analysisActive)
   {
-    if (i >= iFreqDataLength)
-    {
-      break;
-    }
-
-    float height = freq_data[i];
+    // Read the time stamp before the samples: everything AudioData delivered
+    // up to that time is in the ring by now
+    const int64_t audioTime = m_lastAudioDataTime.load(std::memory_order_acquire);
 
-    if (height > m_visBarMaxHeight)
+    size_t count = m_samples.pop(m_analysisBuffer.data(), m_analysisBuffer.size());
+    if (!count)
     {
-      height = m_visBarMaxHeight;
+      std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+      continue;
     }
-    else if (height < m_visBarMinHeight)
+
+    // This part is essentially the same as what Kodi would do if we'd set "pInfo->bWantsFreq = true" (in the GetInfo methode)
+    // However, even though Kodi can do windowing (Hann window) they set the flag for it to "false" (hardcoded).
+    // So I just copied the "rfft.h" and "rfft.cpp", renamed the classe to "MRFFT" (otherwise we'd use the original) and
+    // made the window selectable.
+    // The analyser collects the samples and runs a fixed-size FFT every "m_fftHop" frames, no matter how Kodi chunks
+    // the audio.
+    if (!m_analyser.process(m_analysisBuffer.data(), count / m_analyser.input_channels()))
+      continue;
+
+    const float* levels = m_analyser.levels();
+    GLfloat* heights = m_barFrames.write_buffer().heights.data();
+    for (int i = 0; i < m_visBarCount; i++)
     {
-      height = m_visBarMinHeight;
+      heights[i] = m_visBarMinHeight + levels[i] * (m_visBarMaxHeight - m_visBarMinHeight);
     }
-
-    m_visBarHeights[i] = height;
+    m_barFrames.publish();
+
+    const int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+    const uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::duration(now - audioTime)).count();
+    m_latencyCount++;
+    m_latencySumUs += latency;
+    if (latency > m_latencyMaxUs)
+      m_latencyMaxUs = latency;
   }
-
-  delete[] freq_data;
 }
 
 
@@ -557,6 +748,8 @@ void CVisPictureIt::load_next_image()
       load_next_image();
       return;
     }
+
+    m_imgOpaque = is_opaque(m_imgData, m_imgWidth, m_imgHeight, m_imgChannels);
   }
   else
   {
@@ -567,10 +760,12 @@ void CVisPictureIt::load_next_image()
   m_imgLoaderActive = false;
 }
 
-void CVisPictureIt::draw_image(GLuint img_tex_id, float opacity)
+void CVisPictureIt::draw_image(GLuint img_tex_id, float opacity, bool opaque)
 {
   /**
-   * Draw the image with a certain opacity (opacity is used to cross-fade two images)
+   * Draw the image with a certain opacity (used to fade in the first image).
+   * "opaque" tells whether the image itself has no transparent pixels, in
+   * which case it replaces the screen content at full opacity.
    */
   if (!img_tex_id)
   {
@@ -579,8 +774,16 @@ void CVisPictureIt::draw_image(GLuint img_tex_id, float opacity)
 
   sLight framedTextures[4];
 
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  const bool blend = !opaque || opacity < 1.0f;
+  if (blend)
+  {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+  else
+  {
+    glDisable(GL_BLEND);
+  }
 
   glBindTexture(GL_TEXTURE_2D, img_tex_id);
 
@@ -601,110 +804,513 @@ void CVisPictureIt::draw_image(GLuint img_tex_id, float opacity)
   framedTextures[2].coord = sCoord(1.0f, 1.0f);
   framedTextures[3].vertex = sPosition(-1.0f, 1.0f);
   framedTextures[3].coord = sCoord(0.0f, 1.0f);
-  m_textureUsed = true;
-  EnableShader();
-  glBufferData(GL_ARRAY_BUFFER, sizeof(sLight)*4, framedTextures, GL_STATIC_DRAW);
-  glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, 0);
-  DisableShader();
+  use_program(m_texturedShader);
+  draw_quad(framedTextures);
+
+  glDisable(GL_BLEND);
+}
+
+void CVisPictureIt::draw_strip()
+{
+  /**
+   * The transparent background which goes behind the spectrum
+   */
+  sLight framedTextures[4];
+  framedTextures[0].color = framedTextures[1].color = framedTextures[2].color = framedTextures[3].color = sColor(0.0f, 0.0f, 0.0f, 0.7f);
+  framedTextures[0].vertex = sPosition(1.0f, (m_visBottomEdge - m_visBarMaxHeight) - (1.0f - m_visBottomEdge));
+  framedTextures[1].vertex = sPosition(-1.0f,(m_visBottomEdge - m_visBarMaxHeight) - (1.0f - m_visBottomEdge));
+  framedTextures[2].vertex = sPosition(-1.0f, 1.0f);
+  framedTextures[3].vertex = sPosition( 1.0f, 1.0f);
+
+  use_program(m_solidShader);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  draw_quad(framedTextures);
+  glDisable(GL_BLEND);
+}
+
+bool CVisPictureIt::update_background_target()
+{
+  /**
+   * Keep "m_background" at the size of the viewport we render into. Returns
+   * false if there's no usable target, the background then gets drawn
+   * directly.
+   */
+  if (m_backgroundFailed)
+    return false;
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  const int width = std::max(1, static_cast<int>(viewport[2] * m_backgroundScale));
+  const int height = std::max(1, static_cast<int>(viewport[3] * m_backgroundScale));
+  if (m_background.valid() && m_background.width() == width && m_background.height() == height)
+    return true;
+
+  if (!m_background.create(width, height))
+  {
+    kodi::Log(ADDON_LOG_WARNING, "Can't render offscreen, drawing the background every frame");
+    m_backgroundFailed = true;
+    return false;
+  }
+
+  kodi::Log(ADDON_LOG_DEBUG, "Caching the background at %ix%i", width, height);
+  m_backgroundDirty = true;
+  return true;
+}
+
+void CVisPictureIt::draw_background()
+{
+  /**
+   * Draw the cached background. Its texture starts with the bottom row, so
+   * the texture coordinates are upside down compared to "draw_image".
+   */
+  sLight framedTextures[4];
+  framedTextures[0].color = framedTextures[1].color = framedTextures[2].color = framedTextures[3].color = sColor(1.0f, 1.0f, 1.0f, 1.0f);
+  framedTextures[0].vertex = sPosition(-1.0f, -1.0f);
+  framedTextures[0].coord = sCoord(0.0f, 1.0f);
+  framedTextures[1].vertex = sPosition(1.0f, -1.0f);
+  framedTextures[1].coord = sCoord(1.0f, 1.0f);
+  framedTextures[2].vertex = sPosition(1.0f, 1.0f);
+  framedTextures[2].coord = sCoord(1.0f, 0.0f);
+  framedTextures[3].vertex = sPosition(-1.0f, 1.0f);
+  framedTextures[3].coord = sCoord(0.0f, 0.0f);
+
+  glDisable(GL_BLEND);
+  glBindTexture(GL_TEXTURE_2D, m_background.texture());
+  use_program(m_texturedShader);
+  draw_quad(framedTextures);
+}
+
+void CVisPictureIt::draw_crossfade(GLuint from_tex_id, GLuint to_tex_id, float progress, bool opaque)
+{
+  /**
+   * Draw both images of a crossfade in one pass. Every pixel gets shaded
+   * and written once. "opaque" tells whether both images have no
+   * transparent pixels, only then the result replaces the screen content
+   * without blending. Otherwise the premultiplied mix of the shader is
+   * blended over it, which fades between both images as "draw_image" shows
+   * them.
+   */
+  sLight framedTextures[4];
+  framedTextures[0].color = framedTextures[1].color = framedTextures[2].color = framedTextures[3].color = sColor(1.0f, 1.0f, 1.0f, 1.0f);
+  framedTextures[0].vertex = sPosition(-1.0f, -1.0f);
+  framedTextures[0].coord = sCoord(0.0f, 0.0f);
+  framedTextures[1].vertex = sPosition(1.0f, -1.0f);
+  framedTextures[1].coord = sCoord(1.0f, 0.0f);
+  framedTextures[2].vertex = sPosition(1.0f, 1.0f);
+  framedTextures[2].coord = sCoord(1.0f, 1.0f);
+  framedTextures[3].vertex = sPosition(-1.0f, 1.0f);
+  framedTextures[3].coord = sCoord(0.0f, 1.0f);
+
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, to_tex_id);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, from_tex_id);
 
+  if (opaque)
+  {
+    glDisable(GL_BLEND);
+  }
+  else
+  {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  }
+
+  use_program(m_crossfadeShader);
+  m_crossfadeShader.set_fade(progress);
+  draw_quad(framedTextures);
   glDisable(GL_BLEND);
+
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void CVisPictureIt::draw_quad(const sLight* quad)
+{
+  /**
+   * Draw a quad given by its corners (in clockwise or counter-clockwise
+   * order) as a triangle strip
+   */
+  const sLight strip[4] = {quad[0], quad[1], quad[3], quad[2]};
+
+  GLint first = m_vertexStream.write(strip, sizeof(strip));
+  if (first >= 0)
+    glDrawArrays(GL_TRIANGLE_STRIP, first, 4);
+}
+
+void CVisPictureIt::select_bar_renderer()
+{
+  /**
+   * Prefer generating the bars on the GPU: per frame that uploads a few
+   * hundred bytes of heights instead of the whole mesh. On GLES 3 the
+   * instanced mesh does so without the per-vertex index stream the bar
+   * shader needs there. Fall back to the vertex upload if neither is
+   * available on this GPU.
+   */
+  bool instancing = CInstancedBarShader::supported();
+  switch (m_barRendererSetting)
+  {
+    case BarRenderer::Auto:
+#if defined(HAS_GL)
+      m_barRenderer = BarRenderer::Shader;
+#else
+      m_barRenderer = instancing ? BarRenderer::Instanced : BarRenderer::Shader;
+#endif
+      break;
+    case BarRenderer::Instanced:
+      m_barRenderer = instancing ? BarRenderer::Instanced : BarRenderer::Vertices;
+      break;
+    default:
+      m_barRenderer = m_barRendererSetting;
+      break;
+  }
+
+  if (m_barRenderer == BarRenderer::Instanced && !m_instancedBarShaderLoaded && !m_instancedBarShaderFailed)
+  {
+    std::string fraqShader = kodi::addon::GetAddonPath("resources/shaders/" GL_TYPE_STRING "/frag.glsl");
+    std::string vertShader = kodi::addon::GetAddonPath("resources/shaders/" GL_TYPE_STRING "/bars_instanced_vert.glsl");
+    m_instancedBarShaderLoaded = m_instancedBarShader.LoadShaderFiles(vertShader, fraqShader) &&
+                                 m_instancedBarShader.CompileAndLink(GLSL_VERSION, "", GLSL_VERSION, "");
+    m_instancedBarShaderFailed = !m_instancedBarShaderLoaded;
+  }
+
+  if (m_barRenderer == BarRenderer::Instanced && !m_instancedBarShaderLoaded)
+    m_barRenderer = m_barRendererSetting == BarRenderer::Auto ? BarRenderer::Shader : BarRenderer::Vertices;
+
+  if (m_barRenderer == BarRenderer::Shader && !m_barShaderLoaded && !m_barShaderFailed)
+  {
+    std::string fraqShader = kodi::addon::GetAddonPath("resources/shaders/" GL_TYPE_STRING "/frag.glsl");
+    std::string vertShader = kodi::addon::GetAddonPath("resources/shaders/" GL_TYPE_STRING "/bars_vert.glsl");
+    m_barShaderLoaded = m_barShader.LoadShaderFiles(vertShader, fraqShader) &&
+                         m_barShader.CompileAndLink(GLSL_VERSION, "", GLSL_VERSION, "");
+    m_barShaderFailed = !m_barShaderLoaded;
+  }
+
+  if (m_barRenderer == BarRenderer::Shader && (!m_barShaderLoaded || m_visBarCount > CBarShader::MAX_BARS))
+    m_barRenderer = BarRenderer::Vertices;
+
+  if (m_barRendererSetting != BarRenderer::Auto && m_barRenderer != m_barRendererSetting)
+    kodi::Log(ADDON_LOG_WARNING, "Selected bar renderer unavailable, uploading the bar vertices instead");
+
+  static const char* names[] = {"auto", "vertex uploads", "the bar shader", "instancing"};
+  kodi::Log(ADDON_LOG_DEBUG, "Drawing bars with %s", names[static_cast<int>(m_barRenderer)]);
 }
 
-void CVisPictureIt::draw_bars(int i, GLfloat x1, GLfloat x2)
+void CVisPictureIt::build_bars()
 {
+  if (m_barRenderer == BarRenderer::Shader)
+  {
+    m_barShader.build(m_visBarsDrawn);
+    return;
+  }
+  if (m_barRenderer == BarRenderer::Instanced)
+  {
+    m_instancedBarShader.build(m_visBarsDrawn, m_visWidth);
+    return;
+  }
+
   /**
-   * Draw a single bar
-   * i = index of the bar from left to right
-   * x1 + x2 = width and position of the bar
+   * Build everything about the bar mesh which doesn't change per frame:
+   * x-positions, bottom edge and color of all vertices plus the index buffer.
+   * Bar i uses the vertices 8*i to 8*i+3, its mirrored counterpart on the
+   * right side 8*i+4 to 8*i+7. This ensures the exact same height-value for
+   * both the left and the (mirrored) right bar.
    */
+  m_barVertices.assign(8 * m_visBarsDrawn, sLight());
+  std::vector<GLushort> indices(12 * m_visBarsDrawn);
 
-  if (::fabs(m_cvisBarHeights[i] - m_visBarHeights[i]) > 0)
+  GLfloat x1, x2;
+  float bar_width = m_visWidth / m_visBarsDrawn;
+  for (int i = 0; i < m_visBarsDrawn; i++)
   {
-    // The bigger the difference between the current and previous heights, the faster
-    // we want the bars to move.
-    // The "10.0" is a random value I choose after some testing.
-    float gravity = ::fabs(m_cvisBarHeights[i] - m_pvisBarHeights[i]) / 10.0;
+    // calculate position
+    x1 = (m_visWidth * -1) + (i * bar_width);
+    x2 = (m_visWidth * -1) + ((i + 1) * bar_width);
+
+    // "add" a gap (which is 1/4 of the initial bar_width)
+    // to both the left and right side of the bar
+    x1 = x1 + (bar_width / 4);
+    x2 = x2 - (bar_width / 4);
+
+    sLight* bar = &m_barVertices[8 * i];
+    for (int j = 0; j < 8; j++)
+      bar[j].color = sColor(1.0f, 1.0f, 1.0f, 1.0f);
+
+    bar[0].vertex = sPosition(x1, m_visBottomEdge);   // Top Left
+    bar[1].vertex = sPosition(x2, m_visBottomEdge);   // Top Right
+    bar[2].vertex = sPosition(x2, m_visBottomEdge);   // Bottom Right
+    bar[3].vertex = sPosition(x1, m_visBottomEdge);   // Bottom Left
+
+    bar[4].vertex = sPosition(-x2, m_visBottomEdge);  // Top Left
+    bar[5].vertex = sPosition(-x1, m_visBottomEdge);  // Top Right
+    bar[6].vertex = sPosition(-x1, m_visBottomEdge);  // Bottom Right
+    bar[7].vertex = sPosition(-x2, m_visBottomEdge);  // Bottom Left
+
+    // Two triangles per quad
+    for (int q = 0; q < 2; q++)
+    {
+      GLushort base = static_cast<GLushort>(8 * i + 4 * q);
+      GLushort* index = &indices[12 * i + 6 * q];
+      index[0] = base;     index[1] = base + 1; index[2] = base + 2;
+      index[3] = base;     index[4] = base + 2; index[5] = base + 3;
+    }
+  }
 
-    if (m_cvisBarHeights[i] < m_visBarHeights[i])
+  // The index buffer binding is part of the vertex array object, upload
+  // with ours bound so the one of Kodi stays untouched
+  bind_vertex_layout();
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_barIndexVBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * indices.size(), indices.data(), GL_STATIC_DRAW);
+  unbind_vertex_layout();
+}
+
+void CVisPictureIt::draw_bars(const GLfloat* heights)
+{
+  if (m_barRenderer != BarRenderer::Vertices)
+  {
+    // The bar shaders don't read our vertex layout, so don't let GL fetch
+    // it for vertices the buffer doesn't hold
+    unbind_vertex_layout();
+    if (m_barRenderer == BarRenderer::Shader)
     {
-      m_cvisBarHeights[i] += m_visAnimationSpeed + gravity;
+      use_program(m_barShader);
+      m_barShader.draw(heights, m_visBarsDrawn, m_visWidth, m_visBottomEdge);
     }
     else
     {
-      m_cvisBarHeights[i] -= m_visAnimationSpeed + gravity;
+      use_program(m_instancedBarShader);
+      m_instancedBarShader.draw(heights, m_visBarsDrawn, m_visBottomEdge);
     }
+    return;
   }
 
-  m_pvisBarHeights[i] = m_visBarHeights[i];
-  GLfloat y2 = m_visBottomEdge - m_cvisBarHeights[i];
+  use_program(m_solidShader);
 
-  sLight framedTextures[4];
-  framedTextures[0].color = framedTextures[1].color = framedTextures[2].color = framedTextures[3].color = sColor(1.0f, 1.0f, 1.0f, 1.0f);
+  /**
+   * Draw all bars with a single upload and a single draw call.
+   * Only the top edge of every quad changes from frame to frame.
+   */
+  for (int i = 0; i < m_visBarsDrawn; i++)
+  {
+    GLfloat y2 = m_visBottomEdge - heights[i];
 
-  framedTextures[0].vertex = sPosition(x1, y2);               // Top Left
-  framedTextures[1].vertex = sPosition(x2, y2);               // Top Right
-  framedTextures[2].vertex = sPosition(x2, m_visBottomEdge);  // Bottom Right
-  framedTextures[3].vertex = sPosition(x1, m_visBottomEdge);  // Bottom Left
-  glBufferData(GL_ARRAY_BUFFER, sizeof(sLight)*4, framedTextures, GL_STATIC_DRAW);
-  glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, 0);
+    sLight* bar = &m_barVertices[8 * i];
+    bar[0].vertex.y = bar[1].vertex.y = y2;
+    bar[4].vertex.y = bar[5].vertex.y = y2;
+  }
 
-  framedTextures[0].vertex = sPosition(-x2, y2);               // Top Left
-  framedTextures[1].vertex = sPosition(-x1, y2);               // Top Right
-  framedTextures[2].vertex = sPosition(-x1, m_visBottomEdge);  // Bottom Right
-  framedTextures[3].vertex = sPosition(-x2, m_visBottomEdge);  // Bottom Left
-  glBufferData(GL_ARRAY_BUFFER, sizeof(sLight)*4, framedTextures, GL_STATIC_DRAW);
-  glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, 0);
+  GLint first = m_vertexStream.write(m_barVertices.data(), sizeof(sLight) * m_barVertices.size());
+  if (first >= 0)
+  {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_barIndexVBO);
+#if defined(HAS_GL)
+    if (m_hasBaseVertex)
+      glDrawElementsBaseVertex(GL_TRIANGLES, 12 * m_visBarsDrawn, GL_UNSIGNED_SHORT, 0, first);
+    else
+#endif
+    {
+      // Without a base vertex the indices have to start at the bars'
+      // vertices, so move the attribute pointers there for this draw
+      specify_vertex_layout(first);
+      glDrawElements(GL_TRIANGLES, 12 * m_visBarsDrawn, GL_UNSIGNED_SHORT, 0);
+      specify_vertex_layout(0);
+    }
+  }
 }
 
-void CVisPictureIt::start_render()
+void CVisPictureIt::setup_vertex_layout()
 {
   /**
-   * Some initial OpenGL stuff
+   * Create the index buffer of the bars. Where vertex array objects exist,
+   * record the attribute pointers into "m_vertexStream" and that index
+   * buffer once instead of setting them every frame.
+   *
+   * Kodi calls Start again without Stop when the audio format changes, by
+   * then "m_vertexStream" is a new buffer, so replace what the last start
+   * created.
    */
-  // Clear The Screen And The Depth Buffer
-  glClear(GL_COLOR_BUFFER_BIT);
+  release_vertex_layout();
+  glGenBuffers(1, &m_barIndexVBO);
+
+#if defined(HAS_VERTEX_ARRAYS)
+  // A GLES 3 build may still end up with a GLES 2 context
+  if (!gl_version_at_least(3, 0))
+    return;
+
+  GLint prevVAO = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prevVAO);
+  glGenVertexArrays(1, &m_vertexVAO);
+  glBindVertexArray(m_vertexVAO);
+  specify_vertex_layout(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_barIndexVBO);
+  glBindVertexArray(prevVAO);
+#endif
+}
+
+void CVisPictureIt::release_vertex_layout()
+{
+  if (m_barIndexVBO)
+  {
+    glDeleteBuffers(1, &m_barIndexVBO);
+    m_barIndexVBO = 0;
+  }
+#if defined(HAS_VERTEX_ARRAYS)
+  if (m_vertexVAO)
+  {
+    glDeleteVertexArrays(1, &m_vertexVAO);
+    m_vertexVAO = 0;
+  }
+#endif
+}
+
+void CVisPictureIt::specify_vertex_layout(GLint first)
+{
+  size_t base = first * sizeof(sLight);
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_vertexStream.handle());
+
+  glVertexAttribPointer(CQuadShader::ATTRIB_VERTEX, 4, GL_FLOAT, GL_TRUE, sizeof(sLight), BUFFER_OFFSET(base + offsetof(sLight, vertex)));
+  glEnableVertexAttribArray(CQuadShader::ATTRIB_VERTEX);
+
+  glVertexAttribPointer(CQuadShader::ATTRIB_COLOR, 4, GL_FLOAT, GL_TRUE, sizeof(sLight), BUFFER_OFFSET(base + offsetof(sLight, color)));
+  glEnableVertexAttribArray(CQuadShader::ATTRIB_COLOR);
+
+  glVertexAttribPointer(CQuadShader::ATTRIB_COORD, 2, GL_FLOAT, GL_TRUE, sizeof(sLight), BUFFER_OFFSET(base + offsetof(sLight, coord)));
+  glEnableVertexAttribArray(CQuadShader::ATTRIB_COORD);
+}
+
+void CVisPictureIt::bind_vertex_layout()
+{
+#if defined(HAS_VERTEX_ARRAYS)
+  if (m_vertexVAO)
+  {
+    // Kodi may use a vertex array object of its own, we give it back in
+    // "unbind_vertex_layout". The array buffer binding isn't part of the
+    // VAO, but our uploads need it.
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &m_prevVertexVAO);
+    glBindVertexArray(m_vertexVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexStream.handle());
+    return;
+  }
+#endif
+
+  specify_vertex_layout(0);
+}
+
+void CVisPictureIt::unbind_vertex_layout()
+{
+#if defined(HAS_VERTEX_ARRAYS)
+  if (m_vertexVAO)
+  {
+    glBindVertexArray(m_prevVertexVAO);
+    return;
+  }
+#endif
 
-  glBindBuffer(GL_ARRAY_BUFFER, m_vertexVBO);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLubyte)*4, m_index, GL_STATIC_DRAW);
+  glDisableVertexAttribArray(CQuadShader::ATTRIB_VERTEX);
+  glDisableVertexAttribArray(CQuadShader::ATTRIB_COLOR);
+  glDisableVertexAttribArray(CQuadShader::ATTRIB_COORD);
 
-  glVertexAttribPointer(m_hVertex, 4, GL_FLOAT, GL_TRUE, sizeof(sLight), BUFFER_OFFSET(offsetof(sLight, vertex)));
-  glEnableVertexAttribArray(m_hVertex);
+  // Without a vertex array object the index buffer binding is global, and
+  // Kodi may draw with indices from client memory
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
 
-  glVertexAttribPointer(m_hColor, 4, GL_FLOAT, GL_TRUE, sizeof(sLight), BUFFER_OFFSET(offsetof(sLight, color)));
-  glEnableVertexAttribArray(m_hColor);
+void CVisPictureIt::start_render(bool clear)
+{
+  /**
+   * Some initial OpenGL stuff
+   */
+  // Clear the screen, unless an opaque image is about to cover all of it
+  if (clear)
+    glClear(GL_COLOR_BUFFER_BIT);
 
-  glVertexAttribPointer(m_hCoord, 2, GL_FLOAT, GL_TRUE, sizeof(sLight), BUFFER_OFFSET(offsetof(sLight, coord)));
-  glEnableVertexAttribArray(m_hCoord);
+  bind_vertex_layout();
+  m_vertexStream.begin_frame();
+  m_gpuTimer.begin();
 }
 
 void CVisPictureIt::finish_render()
 {
-  glDisableVertexAttribArray(m_hVertex);
-  glDisableVertexAttribArray(m_hColor);
-  glDisableVertexAttribArray(m_hCoord);
+  if (m_boundProgram)
+  {
+    m_boundProgram->DisableShader();
+    m_boundProgram = nullptr;
+  }
+  m_gpuTimer.end();
+  m_vertexStream.end_frame();
+  unbind_vertex_layout();
+}
+
+void CVisPictureIt::update_quality(CTimeline::Clock::time_point frameStart)
+{
+  /**
+   * Feed the cost of the frame to the governor. CPU and GPU work largely
+   * overlap, so whichever took longer is what limits the frame rate. The GPU
+   * time lags a few frames behind, which the averaging window easily covers.
+   */
+  if (!m_governor.enabled())
+    return;
+
+  const float cpuMs = std::chrono::duration<float, std::milli>(CTimeline::Clock::now() - frameStart).count();
+  const float costMs = std::max(cpuMs, m_gpuTimer.result_ms());
+
+  const int previous = m_governor.level();
+  if (!m_governor.update(costMs, m_timeline.now()))
+    return;
+
+  apply_quality();
+  kodi::Log(ADDON_LOG_INFO, "Frames took %.2f ms on average (budget %i ms), quality level %i -> %i: %s",
+            m_governor.average_ms(), m_frameBudgetMs, previous, m_governor.level(),
+            QUALITY_NAMES[m_governor.level()]);
 }
 
-void CVisPictureIt::OnCompiledAndLinked()
+void CVisPictureIt::apply_quality()
 {
-  // Variables passed directly to the Vertex shader
-  m_projMatLoc = glGetUniformLocation(ProgramHandle(), "u_projectionMatrix");
-  m_modelViewMatLoc = glGetUniformLocation(ProgramHandle(), "u_modelViewMatrix");
-  m_textureIdLoc = glGetUniformLocation(ProgramHandle(), "u_textureId");
+  /**
+   * Every level keeps the savings of the ones before it. The levels which
+   * lighten Render(), the part the governor measures, come first, ordered
+   * from least to most visible.
+   */
+  const int level = m_governor.level();
 
-  m_hVertex = glGetAttribLocation(ProgramHandle(), "a_vertex");
-  m_hColor = glGetAttribLocation(ProgramHandle(), "a_color");
-  m_hCoord = glGetAttribLocation(ProgramHandle(), "a_coord");
+  // 1: Cache the background at half resolution (a quarter of the pixels)
+  m_backgroundScale = level >= 1 ? 0.5f : 1.0f;
+
+  // 2: Leave out the strip behind the spectrum, the background cache then
+  // holds the image alone
+  const bool stripDropped = level >= 2;
+  if (stripDropped != m_stripDropped)
+  {
+    m_stripDropped = stripDropped;
+    m_backgroundDirty = true;
+  }
+
+  // 3: Merge neighbouring bars. The analysis keeps its bar count, resizing
+  // it would mean restarting the analysis thread
+  const int drawn = level >= 3 ? (m_visBarCount + 1) / 2 : m_visBarCount;
+  if (drawn != m_visBarsDrawn)
+  {
+    m_visBarsDrawn = drawn;
+    build_bars();
+  }
+
+  // 4: Analyse every other hop, the smoothing hides the lower update rate.
+  // This only frees the analysis thread, which helps when it competes with
+  // Kodi for the same cores but doesn't show in the frame cost.
+  m_analyser.set_hop_stride(level >= 4 ? 2 : 1);
 }
 
-bool CVisPictureIt::OnEnabled()
+void CVisPictureIt::use_program(kodi::gui::gl::CShaderProgram& program)
 {
-  // This is called after glUseProgram()
-  glUniformMatrix4fv(m_projMatLoc, 1, GL_FALSE, glm::value_ptr(m_projMat));
-  glUniformMatrix4fv(m_modelViewMatLoc, 1, GL_FALSE, glm::value_ptr(m_modelMat));
-  glUniform1i(m_textureIdLoc, m_textureUsed);
+  // Programs stay bound until a draw needs another one (or the frame ends)
+  if (m_boundProgram == &program)
+    return;
 
-  return true;
+  program.EnableShader();
+  m_boundProgram = &program;
 }
 
 ADDONCREATOR(CVisPictureIt)
@@ -8,15 +8,32 @@
 
 #pragma once
 
+#include "analyser.h"
+#include "barshader.h"
+#include "governor.h"
+#include "gputimer.h"
+#include "quadshader.h"
+#include "rendertarget.h"
+#include "streambuffer.h"
+#include "spscring.h"
+#include "timeline.h"
+#include "triplebuffer.h"
+
 #include <kodi/addon-instance/Visualization.h>
 #include <kodi/gui/gl/GL.h>
 #include <kodi/gui/gl/Shader.h>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <thread>
 
+// Vertex array objects are part of desktop GL 3.0 and GLES 3.0
+#if defined(HAS_GL) || (defined(HAS_GLES) && HAS_GLES >= 3)
+#define HAS_VERTEX_ARRAYS 1
+#endif
+
 struct sPosition
 {
   sPosition() : x(0.0f), y(0.0f), z(0.0f), u(1.0f) {}
@@ -45,14 +62,11 @@ struct sLight
   sCoord coord;
 };
 
-class MRFFT;
-
 typedef std::vector<std::string> td_vec_str;
 typedef std::map<std::string, td_vec_str> td_map_data;
 
 class ATTR_DLL_LOCAL CVisPictureIt : public kodi::addon::CAddonBase,
-                                     public kodi::addon::CInstanceVisualization,
-                                     public kodi::gui::gl::CShaderProgram
+                                     public kodi::addon::CInstanceVisualization
 {
 public:
   CVisPictureIt();
@@ -72,10 +86,6 @@ public:
   void AudioData(const float* audioData, size_t audioDataLength) override;
   bool UpdateTrack(const kodi::addon::VisualizationTrack& track) override;
 
-  // kodi::gui::gl::CShaderProgram
-  void OnCompiledAndLinked() override;
-  bool OnEnabled() override;
-
 private:
   std::string path_join(std::string a, std::string b);
   bool list_dir(const std::string& path, td_vec_str &store, bool recursive = false,
@@ -85,10 +95,29 @@ private:
   void load_data(const std::string& path);
   void select_preset(unsigned int index);
   void load_next_image();
-  void draw_image(GLuint img_tex_id, float opacity);
-  void draw_bars(int i, GLfloat x1, GLfloat x2);
-  void start_render();
+  void draw_image(GLuint img_tex_id, float opacity, bool opaque);
+  void draw_strip();
+  bool update_background_target();
+  void draw_background();
+  void draw_crossfade(GLuint from_tex_id, GLuint to_tex_id, float progress, bool opaque);
+  void draw_quad(const sLight* quad);
+  void select_bar_renderer();
+  void build_bars();
+  void draw_bars(const GLfloat* heights);
+  void setup_vertex_layout();
+  void release_vertex_layout();
+  void specify_vertex_layout(GLint first);
+  void bind_vertex_layout();
+  void unbind_vertex_layout();
+  void use_program(kodi::gui::gl::CShaderProgram& program);
+  void start_render(bool clear);
   void finish_render();
+  void update_quality(CTimeline::Clock::time_point frameStart);
+  void apply_quality();
+  void start_analysis();
+  void stop_analysis();
+  void block_audio_data();
+  void analysis_thread();
 
   /*
    * Settings
@@ -106,9 +135,32 @@ private:
   // If set to 1.0 the bars would be exactly on the screen edge
   GLfloat m_visBottomEdge = 0.98f;
 
-  // Animation speed. The smaler the value, the slower
-  // and smoother the animations
-  GLfloat m_visAnimationSpeed = 0.007f;
+  // Time constants (in ms) for bars moving up (attack) and down (release).
+  // The bigger the value, the slower and smoother the animations
+  float m_visAttackMs = 40.0f;
+  float m_visReleaseMs = 300.0f;
+
+  // How the bars get their geometry
+  enum class BarRenderer
+  {
+    Auto,
+    Vertices, // All vertices are updated and uploaded every frame
+    Shader,   // Only the heights are uploaded, see "CBarShader"
+    Instanced, // One static mesh drawn per bar, see "CInstancedBarShader"
+  };
+  BarRenderer m_barRendererSetting = BarRenderer::Auto;
+
+  // The renderer chosen in "Start" (never "Auto")
+  BarRenderer m_barRenderer = BarRenderer::Vertices;
+
+  // Frame cost (in ms) to stay within by lowering quality, 0 to always
+  // render at full quality
+  int m_frameBudgetMs = 8;
+
+  // Per-frame smoothing coefficients derived from the time constants above
+  // and the time since the last frame
+  float m_visAttackCoef = 1.0f;
+  float m_visReleaseCoef = 1.0f;
 
   std::shared_ptr<std::thread> m_dataLoader;
   std::atomic<bool> m_dataLoaderActive;
@@ -121,7 +173,46 @@ private:
   unsigned char* m_imgData = nullptr;
   int m_imgWidth, m_imgHeight, m_imgChannels = 0;
 
-  std::unique_ptr<MRFFT> m_tranform;
+  // Whether "m_imgData" has no transparent pixels
+  bool m_imgOpaque = false;
+
+  // Turns the samples from AudioData into bar levels (only touched by the
+  // analysis thread while it runs)
+  CSpectrumAnalyser m_analyser;
+
+  // Samples handed from AudioData to the analysis thread
+  CSPSCRing<float> m_samples;
+  aligned_vector<float> m_analysisBuffer;
+
+  std::shared_ptr<std::thread> m_analysisThread;
+  std::atomic<bool> m_analysisActive{false};
+
+  // Channel count of the samples in "m_samples", so AudioData never needs
+  // to ask the analyser
+  std::atomic<size_t> m_inputChannels{2};
+
+  // Number of AudioData calls currently running, see "block_audio_data"
+  std::atomic<int> m_audioDataCalls{0};
+
+  // Statistics, logged when the analysis stops
+  std::atomic<uint64_t> m_samplesDropped{0};
+  std::atomic<int64_t> m_lastAudioDataTime{0};
+  std::atomic<uint64_t> m_latencyCount{0};
+  std::atomic<uint64_t> m_latencySumUs{0};
+  std::atomic<uint64_t> m_latencyMaxUs{0};
+
+  // Window function applied before the FFT
+  MRFFT::Window m_fftWindow = MRFFT::Window::Hann;
+
+  // Length (in frames) of the FFT window
+  size_t m_fftSize = 2048;
+
+  // Amount of new frames between two FFTs (the remainder overlaps)
+  size_t m_fftHop = 512;
+
+  // Sample rate and channel count of the audio we get from AudioData
+  int m_sampleRate = 44100;
+  int m_channels = 2;
 
   /*
    * "m_imgTextureIds" holds the texture-ids for images:
@@ -131,6 +222,21 @@ private:
    */
   GLuint m_imgTextureIds[3] = {};
 
+  // Whether the image behind each of "m_imgTextureIds" is fully opaque
+  bool m_imgTextureOpaque[3] = {};
+
+  // The current image plus the strip behind the spectrum (if shown), drawn
+  // once and reused for every frame outside of fades
+  CRenderTarget m_background;
+  bool m_backgroundDirty = true;
+  bool m_backgroundFailed = false;
+
+  // Size of "m_background" relative to the viewport
+  float m_backgroundScale = 1.0f;
+
+  // Whether the governor left out the strip behind the spectrum
+  bool m_stripDropped = false;
+
   // When set to "true", a new image will be crossfaded
   bool m_updateImg = false;
 
@@ -146,25 +252,24 @@ private:
 
   int m_imgCurrentPos = 0;
 
-  // Time (in sec.) where we last updated the image
-  time_t m_imgLastUpdated = time(0);
-
-  // The last alpha value of our image
-  GLfloat m_fadeLast = 0.0f;
+  // Frame time, crossfade progress and when to update the image next
+  CTimeline m_timeline;
 
-  // The current alpha value of our image
-  GLfloat m_fadeCurrent = 0.0f;
+  // Lowers quality while frames exceed "m_frameBudgetMs", see
+  // "apply_quality" for what each level does
+  CFrameGovernor m_governor;
+  CGPUTimer m_gpuTimer;
 
   // How long the crossfade between two images will take (in ms)
   int m_fadeTimeMs = 2000;
 
-  // Used in combination with "m_fadeTimeMs" to calculate the new alpha value
-  // for the next frame
-  int m_fadeOffsetMs = 0;
-
   // Amount of single bars to display (will be doubled as we mirror them to
   // the right side)
-  static const int m_visBarCount = 96;
+  int m_visBarCount = 96;
+
+  // Amount of bars drawn, neighbours get merged into one bar while the
+  // governor asks for fewer bars
+  int m_visBarsDrawn = 96;
 
   // The min height for each bar
   const GLfloat m_visBarMinHeight = 0.02f;
@@ -178,14 +283,20 @@ private:
   };
 
   // Whatever we get from AudioData
-  GLfloat m_visBarHeights[m_visBarCount] = {};
+  struct sBarFrame
+  {
+    aligned_vector<GLfloat> heights;
+  };
 
-  // The previous value we got from AudioData (used to calculate some form
-  // of gravity. The bigger the difference, the faster the bars will move)
-  GLfloat m_pvisBarHeights[m_visBarCount] = {};
+  // Hands complete frames from the audio thread (AudioData) to the render
+  // thread (Render) without locking either of them
+  CTripleBuffer<sBarFrame> m_barFrames;
 
   // Used to smoothen the animation on a "per frame" basis.
-  GLfloat m_cvisBarHeights[m_visBarCount] = {};
+  aligned_vector<GLfloat> m_cvisBarHeights;
+
+  // "m_cvisBarHeights" reduced to "m_visBarsDrawn" bars
+  aligned_vector<GLfloat> m_mergedBarHeights;
 
   // Holds all preset-names in alphabetical order
   td_vec_str m_piPresets;
@@ -198,9 +309,6 @@ private:
   // images
   td_map_data m_piData;
 
-  int m_prevFreqDataLength = 0;
-
-  bool m_textureUsed = false;
 
   // OpenGL projection matrix setup
   // Coordinate-System:
@@ -209,22 +317,44 @@ private:
   //     screen bottom right: ( 1,  1)
   const glm::mat4 m_projMat = glm::ortho(-1.0f, 1.0f, 1.0f, -1.0f, -1.0f, 1.0f);
   const glm::mat4 m_modelMat = glm::mat4(1.0f);
-  const GLubyte m_index[4] = {0, 1, 3, 2};
 
-  GLint m_projMatLoc = -1;
-  GLint m_modelViewMatLoc = -1;
-  GLint m_textureIdLoc = -1;
-  GLint m_hVertex = -1;
-  GLint m_hCoord = -1;
-  GLint m_hColor = -1;
+  // Image layers and the strip behind the spectrum (declared after the
+  // matrices they use)
+  CQuadShader m_texturedShader{m_projMat, m_modelMat};
+  CQuadShader m_crossfadeShader{m_projMat, m_modelMat};
+  CQuadShader m_solidShader{m_projMat, m_modelMat};
+
+  // The program in use during a frame, see "use_program"
+  kodi::gui::gl::CShaderProgram* m_boundProgram = nullptr;
+
+  // All geometry written per frame
+  CStreamBuffer m_vertexStream;
+  GLuint m_barIndexVBO = 0;
+
+  // Whether glDrawElementsBaseVertex can be used (GL 3.2)
+  bool m_hasBaseVertex = false;
+
+  // Records our attribute layout and index buffer where vertex array
+  // objects exist (0 otherwise), see "setup_vertex_layout"
+  GLuint m_vertexVAO = 0;
+  GLint m_prevVertexVAO = 0;
+
+  // Vertices of all bars, see "build_bars"
+  std::vector<sLight> m_barVertices;
 
-  GLuint m_vertexVBO = 0;
-  GLuint m_indexVBO = 0;
+  // Generates the bars on the GPU (declared after the matrices it uses)
+  CBarShader m_barShader{m_projMat, m_modelMat};
+  CInstancedBarShader m_instancedBarShader{m_projMat, m_modelMat};
 
   GLuint m_texture = 0;
 
-  bool m_initialized = false;
+  // Written on the GL thread, read by AudioData on the audio thread
+  std::atomic<bool> m_initialized{false};
   bool m_shadersLoaded = false;
+  bool m_barShaderLoaded = false;
+  bool m_barShaderFailed = false;
+  bool m_instancedBarShaderLoaded = false;
+  bool m_instancedBarShaderFailed = false;
 
   unsigned int m_get_next_img_pos_Calls = 0;
   std::string m_last_path;
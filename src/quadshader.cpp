@@ -0,0 +1,71 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "quadshader.h"
+#include "glversion.h"
+
+CQuadShader::CQuadShader(const glm::mat4& projMat, const glm::mat4& modelMat)
+  : m_projMat(projMat),
+    m_modelMat(modelMat)
+{
+}
+
+bool CQuadShader::load(const std::string& vertShader, const std::string& fragShader, Variant variant)
+{
+  std::string header = GLSL_VERSION;
+  if (variant != Variant::Solid)
+    header += "#define TEXTURED\n";
+  if (variant == Variant::Crossfade)
+    header += "#define CROSSFADE\n";
+
+  return LoadShaderFiles(vertShader, fragShader) && CompileAndLink(header, "", header, "");
+}
+
+void CQuadShader::set_fade(GLfloat fade)
+{
+  if (fade != m_fade)
+  {
+    glUniform1f(m_fadeLoc, fade);
+    m_fade = fade;
+  }
+}
+
+void CQuadShader::OnCompiledAndLinked()
+{
+  // Attribute locations only take effect on the next link, so pin them and
+  // link once more. Otherwise each variant would get its own layout.
+  glBindAttribLocation(ProgramHandle(), ATTRIB_VERTEX, "a_vertex");
+  glBindAttribLocation(ProgramHandle(), ATTRIB_COLOR, "a_color");
+  glBindAttribLocation(ProgramHandle(), ATTRIB_COORD, "a_coord");
+  glLinkProgram(ProgramHandle());
+
+  m_projMatLoc = glGetUniformLocation(ProgramHandle(), "u_projectionMatrix");
+  m_modelViewMatLoc = glGetUniformLocation(ProgramHandle(), "u_modelViewMatrix");
+  m_texUnitLoc = glGetUniformLocation(ProgramHandle(), "u_texUnit");
+  m_texUnit2Loc = glGetUniformLocation(ProgramHandle(), "u_texUnit2");
+  m_fadeLoc = glGetUniformLocation(ProgramHandle(), "u_fade");
+
+  // A (re)linked program starts with all uniforms zeroed
+  m_uniformsDirty = true;
+  m_fade = 0.0f;
+}
+
+bool CQuadShader::OnEnabled()
+{
+  // This is called after glUseProgram(). The matrices never change, so
+  // they only need uploading once after linking.
+  if (m_uniformsDirty)
+  {
+    glUniformMatrix4fv(m_projMatLoc, 1, GL_FALSE, glm::value_ptr(m_projMat));
+    glUniformMatrix4fv(m_modelViewMatLoc, 1, GL_FALSE, glm::value_ptr(m_modelMat));
+    glUniform1i(m_texUnitLoc, 0);
+    glUniform1i(m_texUnit2Loc, 1);
+    m_uniformsDirty = false;
+  }
+
+  return true;
+}
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/gui/gl/GL.h>
+#include <kodi/gui/gl/Shader.h>
+#include <glm/gtc/type_ptr.hpp>
+
+//! \brief Program for the quads built from "sLight" vertices: the image
+//! layers, the crossfade between two of them and the flat strip behind the
+//! spectrum.
+//!
+//! All variants come from "vert.glsl"/"frag.glsl", built with different
+//! defines. They share one fixed attribute layout, so one vertex array
+//! object serves all of them.
+class CQuadShader : public kodi::gui::gl::CShaderProgram
+{
+public:
+  //! Attribute locations of both variants
+  static const GLuint ATTRIB_VERTEX = 0;
+  static const GLuint ATTRIB_COLOR = 1;
+  static const GLuint ATTRIB_COORD = 2;
+
+  enum class Variant
+  {
+    Solid,     // Vertex color only
+    Textured,  // Texture unit 0 times the vertex color
+    Crossfade, // Texture units 0 and 1 mixed by "set_fade", times the vertex color
+  };
+
+  CQuadShader(const glm::mat4& projMat, const glm::mat4& modelMat);
+
+  //! \brief Load, compile and link one variant.
+  bool load(const std::string& vertShader, const std::string& fragShader, Variant variant);
+
+  //! \brief How far the crossfade got (0: texture unit 0 only, 1: texture
+  //! unit 1 only). The program must be bound.
+  void set_fade(GLfloat fade);
+
+  // kodi::gui::gl::CShaderProgram
+  void OnCompiledAndLinked() override;
+  bool OnEnabled() override;
+
+private:
+  const glm::mat4& m_projMat;
+  const glm::mat4& m_modelMat;
+
+  GLint m_projMatLoc = -1;
+  GLint m_modelViewMatLoc = -1;
+  GLint m_texUnitLoc = -1;
+  GLint m_texUnit2Loc = -1;
+  GLint m_fadeLoc = -1;
+
+  // What the program currently holds, only changes get uploaded
+  bool m_uniformsDirty = true;
+  GLfloat m_fade = 0.0f;
+};
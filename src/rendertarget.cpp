@@ -0,0 +1,77 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "rendertarget.h"
+
+bool CRenderTarget::create(int width, int height)
+{
+  destroy();
+
+  GLint prevFramebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFramebuffer);
+
+  glGenTextures(1, &m_texture);
+  glBindTexture(GL_TEXTURE_2D, m_texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffers(1, &m_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, 0);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, prevFramebuffer);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE)
+  {
+    destroy();
+    return false;
+  }
+
+  m_width = width;
+  m_height = height;
+  return true;
+}
+
+void CRenderTarget::destroy()
+{
+  if (m_framebuffer)
+  {
+    glDeleteFramebuffers(1, &m_framebuffer);
+    m_framebuffer = 0;
+  }
+  if (m_texture)
+  {
+    glDeleteTextures(1, &m_texture);
+    m_texture = 0;
+  }
+  m_width = m_height = 0;
+}
+
+void CRenderTarget::bind()
+{
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_prevFramebuffer);
+  glGetIntegerv(GL_VIEWPORT, m_prevViewport);
+  m_prevScissor = glIsEnabled(GL_SCISSOR_TEST);
+
+  // Kodi's scissor rectangle is meant for its own framebuffer
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glViewport(0, 0, m_width, m_height);
+  if (m_prevScissor)
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void CRenderTarget::unbind()
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, m_prevFramebuffer);
+  glViewport(m_prevViewport[0], m_prevViewport[1], m_prevViewport[2], m_prevViewport[3]);
+  if (m_prevScissor)
+    glEnable(GL_SCISSOR_TEST);
+}
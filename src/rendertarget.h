@@ -0,0 +1,54 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/gui/gl/GL.h>
+
+//! \brief Offscreen framebuffer with a color texture to render into.
+//!
+//! "bind" redirects all drawing into the texture, "unbind" goes back to
+//! whatever framebuffer, viewport and scissor state was in use before
+//! (Kodi may be rendering into a framebuffer of its own).
+class CRenderTarget
+{
+public:
+  CRenderTarget() = default;
+  ~CRenderTarget() = default;
+  CRenderTarget(const CRenderTarget&) = delete;
+  CRenderTarget& operator=(const CRenderTarget&) = delete;
+
+  //! \brief (Re)create the target with the given size, must be called with
+  //! a current context.
+  //! \return false if the driver can't render into such a texture
+  bool create(int width, int height);
+
+  //! \brief Delete the framebuffer and its texture.
+  void destroy();
+
+  bool valid() const { return m_framebuffer != 0; }
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+
+  //! \brief The color texture. Its first row is the bottom of the rendered
+  //! picture, as usual for GL.
+  GLuint texture() const { return m_texture; }
+
+  void bind();
+  void unbind();
+
+private:
+  GLuint m_framebuffer = 0;
+  GLuint m_texture = 0;
+  int m_width = 0;
+  int m_height = 0;
+
+  // State to restore in "unbind"
+  GLint m_prevFramebuffer = 0;
+  GLint m_prevViewport[4] = {};
+  GLboolean m_prevScissor = GL_FALSE;
+};
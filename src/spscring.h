@@ -0,0 +1,99 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "aligned.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+//! \brief Lock-free single-producer/single-consumer ring of trivially
+//! copyable elements.
+//!
+//! push() and pop() never block and never allocate. The capacity is rounded
+//! up to a power of two so the positions can run freely and get masked.
+template<typename T>
+class CSPSCRing
+{
+public:
+  //! \brief Allocate the ring, must not be called while in use.
+  void resize(size_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+
+    m_buffer.assign(size, T());
+    m_mask = size - 1;
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+  }
+
+  size_t capacity() const { return m_buffer.size(); }
+
+  //! \brief Producer: append up to count elements.
+  //! \param granularity Only whole groups of this many elements get written.
+  //! \return Number of elements written, the rest is dropped.
+  size_t push(const T* data, size_t count, size_t granularity = 1)
+  {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    const size_t tail = m_tail.load(std::memory_order_acquire);
+
+    const size_t space = capacity() - (head - tail);
+    count = std::min(count, space - space % granularity);
+    copy_in(head, data, count);
+
+    m_head.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  //! \brief Consumer: take up to count elements.
+  //! \return Number of elements read.
+  size_t pop(T* data, size_t count)
+  {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    const size_t head = m_head.load(std::memory_order_acquire);
+
+    count = std::min(count, head - tail);
+    copy_out(tail, data, count);
+
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  //! \brief Consumer: number of elements ready to be read.
+  size_t available() const
+  {
+    return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed);
+  }
+
+private:
+  void copy_in(size_t position, const T* data, size_t count)
+  {
+    const size_t start = position & m_mask;
+    const size_t first = std::min(count, capacity() - start);
+    memcpy(m_buffer.data() + start, data, first * sizeof(T));
+    memcpy(m_buffer.data(), data + first, (count - first) * sizeof(T));
+  }
+
+  void copy_out(size_t position, T* data, size_t count) const
+  {
+    const size_t start = position & m_mask;
+    const size_t first = std::min(count, capacity() - start);
+    memcpy(data, m_buffer.data() + start, first * sizeof(T));
+    memcpy(data + first, m_buffer.data(), (count - first) * sizeof(T));
+  }
+
+  aligned_vector<T> m_buffer;
+  size_t m_mask = 0;
+
+  // Written by one side each, kept on separate cache lines
+  alignas(64) std::atomic<size_t> m_head{0};
+  alignas(64) std::atomic<size_t> m_tail{0};
+};
@@ -0,0 +1,164 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "streambuffer.h"
+#include "glversion.h"
+
+#include <cstring>
+
+void CStreamBuffer::create(size_t frameSize, size_t stride)
+{
+  destroy();
+
+  // Segments start on a vertex boundary, so every write can be addressed
+  // by the index of its first vertex
+  m_stride = stride;
+  m_segmentSize = (frameSize + stride - 1) / stride * stride;
+  m_segment = SEGMENTS - 1;
+  m_head = m_segmentSize;
+
+  glGenBuffers(1, &m_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+
+  m_mode = Mode::Orphan;
+#if defined(HAS_GL)
+  if (gl_version_at_least(3, 2))
+    m_mode = Mode::Unsynchronized;
+#if defined(GL_VERSION_4_4)
+  if (gl_version_at_least(4, 4))
+    m_mode = Mode::Persistent;
+#endif
+#elif defined(HAS_MAPPED_BUFFERS)
+  if (gl_version_at_least(3, 0))
+    m_mode = Mode::Unsynchronized;
+#endif
+
+#if defined(GL_VERSION_4_4)
+  if (m_mode == Mode::Persistent)
+  {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, m_segmentSize * SEGMENTS, nullptr, flags);
+    m_mapped = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, m_segmentSize * SEGMENTS, flags));
+    if (!m_mapped)
+    {
+      // The storage is immutable now, start over with a fresh buffer
+      glDeleteBuffers(1, &m_buffer);
+      glGenBuffers(1, &m_buffer);
+      glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+      m_mode = Mode::Unsynchronized;
+    }
+  }
+#endif
+
+  if (m_mode != Mode::Persistent)
+    glBufferData(GL_ARRAY_BUFFER, m_segmentSize * SEGMENTS, nullptr, GL_STREAM_DRAW);
+}
+
+void CStreamBuffer::destroy()
+{
+  if (!m_buffer)
+    return;
+
+#if defined(HAS_MAPPED_BUFFERS)
+  for (GLsync& fence : m_fences)
+  {
+    if (fence)
+      glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  if (m_mapped)
+  {
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    m_mapped = nullptr;
+  }
+#endif
+
+  glDeleteBuffers(1, &m_buffer);
+  m_buffer = 0;
+}
+
+const char* CStreamBuffer::mode_name() const
+{
+  switch (m_mode)
+  {
+    case Mode::Persistent:
+      return "persistent mapping";
+    case Mode::Unsynchronized:
+      return "unsynchronized mapping";
+    default:
+      return "orphaning";
+  }
+}
+
+void CStreamBuffer::begin_frame()
+{
+  m_segment = (m_segment + 1) % SEGMENTS;
+  m_head = m_segment * m_segmentSize;
+
+#if defined(HAS_MAPPED_BUFFERS)
+  if (m_mode != Mode::Orphan)
+  {
+    // Written SEGMENTS frames ago, usually long done by now
+    GLsync& fence = m_fences[m_segment];
+    if (fence)
+    {
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+    return;
+  }
+#endif
+
+  // Hand the old storage to the driver (which frees it once the GPU is done
+  // with it) and carry on with fresh storage
+  if (m_segment == 0)
+    glBufferData(GL_ARRAY_BUFFER, m_segmentSize * SEGMENTS, nullptr, GL_STREAM_DRAW);
+}
+
+void CStreamBuffer::end_frame()
+{
+#if defined(HAS_MAPPED_BUFFERS)
+  if (m_mode != Mode::Orphan)
+    m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+}
+
+GLint CStreamBuffer::write(const void* data, size_t size)
+{
+  size_t end = (m_segment + 1) * m_segmentSize;
+  if (m_head + size > end)
+    return -1;
+
+  switch (m_mode)
+  {
+    case Mode::Persistent:
+      memcpy(m_mapped + m_head, data, size);
+      break;
+#if defined(HAS_MAPPED_BUFFERS)
+    case Mode::Unsynchronized:
+    {
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+      void* target = glMapBufferRange(GL_ARRAY_BUFFER, m_head, size, flags);
+      if (!target)
+        return -1;
+      memcpy(target, data, size);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      break;
+    }
+#endif
+    default:
+      glBufferSubData(GL_ARRAY_BUFFER, m_head, size, data);
+      break;
+  }
+
+  GLint first = static_cast<GLint>(m_head / m_stride);
+  m_head += (size + m_stride - 1) / m_stride * m_stride;
+  return first;
+}
@@ -0,0 +1,87 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/gui/gl/GL.h>
+
+#include <cstddef>
+
+// Mapped buffers and sync objects are part of desktop GL 3.2 and GLES 3.0
+#if defined(HAS_GL) || (defined(HAS_GLES) && HAS_GLES >= 3)
+#define HAS_MAPPED_BUFFERS 1
+#endif
+
+//! \brief Vertex buffer for geometry which changes every frame.
+//!
+//! The buffer is split into one segment per frame in flight. Every frame
+//! writes into the next segment, so the driver never has to wait for (or
+//! copy) data the GPU may still be reading. Depending on the context the
+//! data gets there by:
+//!  - Persistent: a buffer mapped once for its whole lifetime (GL 4.4),
+//!    segments are guarded by fences
+//!  - Unsynchronized: unsynchronized glMapBufferRange (GL 3.2, GLES 3.0),
+//!    segments are guarded by fences
+//!  - Orphan: glBufferSubData, orphaning the storage whenever the ring
+//!    wraps around (GLES 2.0)
+class CStreamBuffer
+{
+public:
+  enum class Mode
+  {
+    Orphan,
+    Unsynchronized,
+    Persistent,
+  };
+
+  CStreamBuffer() = default;
+  ~CStreamBuffer() = default;
+  CStreamBuffer(const CStreamBuffer&) = delete;
+  CStreamBuffer& operator=(const CStreamBuffer&) = delete;
+
+  //! \brief Create the buffer, must be called with a current context.
+  //! \param frameSize The most bytes written per frame
+  //! \param stride Size of one vertex, every write starts at a multiple of it
+  void create(size_t frameSize, size_t stride);
+
+  //! \brief Delete the buffer and everything belonging to it.
+  void destroy();
+
+  GLuint handle() const { return m_buffer; }
+  Mode mode() const { return m_mode; }
+  const char* mode_name() const;
+
+  //! \brief Switch to the next segment, waiting for the GPU to be done with
+  //! it if needed. The buffer must be bound to GL_ARRAY_BUFFER.
+  void begin_frame();
+
+  //! \brief Mark the end of the draws reading the current segment.
+  void end_frame();
+
+  //! \brief Copy "size" bytes into the current segment.
+  //! The buffer must be bound to GL_ARRAY_BUFFER.
+  //! \return Index (in multiples of "stride") of the first written vertex,
+  //!         -1 if the segment has no room left
+  GLint write(const void* data, size_t size);
+
+private:
+  static const int SEGMENTS = 3;
+
+  GLuint m_buffer = 0;
+  Mode m_mode = Mode::Orphan;
+  size_t m_stride = 1;
+  size_t m_segmentSize = 0;
+  int m_segment = 0;
+  size_t m_head = 0;
+
+  // Only used by Mode::Persistent
+  char* m_mapped = nullptr;
+
+#if defined(HAS_MAPPED_BUFFERS)
+  GLsync m_fences[SEGMENTS] = {};
+#endif
+};
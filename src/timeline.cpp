@@ -0,0 +1,64 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "timeline.h"
+
+#include <algorithm>
+
+void CTimeline::advance(Clock::time_point now)
+{
+  m_frameMs = m_started ? std::chrono::duration<float, std::milli>(now - m_now).count() : 0.0f;
+  m_now = now;
+  m_started = true;
+}
+
+void CTimeline::start_fade(float durationMs)
+{
+  m_fadeStart = m_now;
+  m_fadeMs = durationMs;
+  m_fadeActive = true;
+}
+
+bool CTimeline::fading() const
+{
+  return m_fadeActive && fade_progress() < 1.0f;
+}
+
+float CTimeline::fade_progress() const
+{
+  if (!m_fadeActive || m_fadeMs <= 0.0f)
+    return 1.0f;
+
+  float elapsed = std::chrono::duration<float, std::milli>(m_now - m_fadeStart).count();
+  return std::min(elapsed / m_fadeMs, 1.0f);
+}
+
+bool CTimeline::fade_finished()
+{
+  if (!m_fadeActive || fade_progress() < 1.0f)
+    return false;
+
+  m_fadeActive = false;
+  return true;
+}
+
+void CTimeline::schedule(Event event, float delayMs)
+{
+  sSchedule& entry = m_events[static_cast<int>(event)];
+  entry.time = m_now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(delayMs));
+  entry.pending = true;
+}
+
+bool CTimeline::due(Event event)
+{
+  sSchedule& entry = m_events[static_cast<int>(event)];
+  if (!entry.pending || m_now < entry.time)
+    return false;
+
+  entry.pending = false;
+  return true;
+}
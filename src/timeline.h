@@ -0,0 +1,78 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <chrono>
+
+//! \brief Monotonic time base for everything animated.
+//!
+//! The clock is sampled once per frame ("advance"), frame delta, fade
+//! progress and scheduled events all derive from that sample. So
+//! everything drawn in one frame agrees on the time, and feeding
+//! "advance" with made up time points replays any sequence of frames.
+class CTimeline
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  //! Things that happen at a certain time
+  enum class Event
+  {
+    NextImage, // Time to request the next image of the preset
+    Count,
+  };
+
+  //! \brief Start a new frame at the current time.
+  void advance() { advance(Clock::now()); }
+
+  //! \brief Start a new frame at "now", which must not be before the last
+  //! frame.
+  void advance(Clock::time_point now);
+
+  Clock::time_point now() const { return m_now; }
+
+  //! \brief Milliseconds since the previous frame (0 on the first one).
+  float frame_ms() const { return m_frameMs; }
+
+  //! \brief Start a fade at the current frame.
+  void start_fade(float durationMs);
+
+  //! \brief Whether a fade is going on and hasn't reached its end yet.
+  bool fading() const;
+
+  //! \brief Progress of the fade, from 0 (its first frame) to 1 (done, or
+  //! no fade at all).
+  float fade_progress() const;
+
+  //! \brief True once, in the first frame the current fade is complete.
+  bool fade_finished();
+
+  //! \brief Let "event" become due "delayMs" after the current frame.
+  //! Replaces an earlier schedule of the same event.
+  void schedule(Event event, float delayMs);
+
+  //! \brief True once, in the first frame at or after the time "event" was
+  //! scheduled for.
+  bool due(Event event);
+
+private:
+  Clock::time_point m_now;
+  bool m_started = false;
+  float m_frameMs = 0.0f;
+
+  Clock::time_point m_fadeStart;
+  float m_fadeMs = 0.0f;
+  bool m_fadeActive = false;
+
+  struct sSchedule
+  {
+    Clock::time_point time;
+    bool pending = false;
+  };
+  sSchedule m_events[static_cast<int>(Event::Count)];
+};
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+
+//! \brief Lock-free triple buffer handing complete frames from one producer
+//! thread to one consumer thread.
+//!
+//! The producer fills write_buffer() and calls publish(), the consumer calls
+//! update() and reads read_buffer(). Both sides own one buffer exclusively and
+//! swap it with the shared middle buffer through a single atomic exchange, so
+//! neither side ever blocks or sees a partially written frame. If the producer
+//! is faster, intermediate frames are dropped and the consumer always gets the
+//! newest one.
+template<typename T>
+class CTripleBuffer
+{
+public:
+  //! \brief Set all buffers to value and forget any published frame.
+  //! Must not be called while producer or consumer are active.
+  void reset(const T& value)
+  {
+    for (auto& buffer : m_buffers)
+      buffer = value;
+    m_write = 0;
+    m_read = 1;
+    m_middle.store(2, std::memory_order_relaxed);
+  }
+
+  //! \brief Buffer owned by the producer.
+  T& write_buffer() { return m_buffers[m_write]; }
+
+  //! \brief Make the write buffer available to the consumer.
+  void publish()
+  {
+    unsigned int previous = m_middle.exchange(m_write | FRESH, std::memory_order_acq_rel);
+    m_write = previous & INDEX;
+  }
+
+  //! \brief Take the newest published frame, if any.
+  //! \return true if read_buffer() changed.
+  bool update()
+  {
+    if (!(m_middle.load(std::memory_order_relaxed) & FRESH))
+      return false;
+
+    unsigned int previous = m_middle.exchange(m_read, std::memory_order_acq_rel);
+    m_read = previous & INDEX;
+    return true;
+  }
+
+  //! \brief Buffer owned by the consumer.
+  const T& read_buffer() const { return m_buffers[m_read]; }
+
+private:
+  static constexpr unsigned int INDEX = 0x3;
+  static constexpr unsigned int FRESH = 0x4;
+
+  T m_buffers[3] = {};
+  unsigned int m_write = 0;
+  unsigned int m_read = 1;
+  std::atomic<unsigned int> m_middle{2};
+};
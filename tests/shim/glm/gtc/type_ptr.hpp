@@ -0,0 +1,44 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+// The few glm types the addon uses, only their storage matters here
+
+namespace glm
+{
+
+struct mat4
+{
+  mat4() = default;
+  explicit mat4(float s) { for (int i = 0; i < 16; i++) v[i] = i % 5 ? 0.0f : s; }
+  float v[16] = {};
+};
+
+struct vec2
+{
+  explicit vec2(float s = 0.0f) : x(s), y(s) {}
+  vec2(float x, float y) : x(x), y(y) {}
+  bool operator!=(const vec2& o) const { return x != o.x || y != o.y; }
+  float x, y;
+};
+
+struct vec3
+{
+  explicit vec3(float s = 0.0f) : x(s), y(s), z(s) {}
+  vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+  bool operator!=(const vec3& o) const { return x != o.x || y != o.y || z != o.z; }
+  float x, y, z;
+};
+
+inline mat4 ortho(float, float, float, float, float, float) { return mat4(1.0f); }
+
+inline const float* value_ptr(const mat4& m) { return m.v; }
+inline const float* value_ptr(const vec2& v) { return &v.x; }
+inline const float* value_ptr(const vec3& v) { return &v.x; }
+
+} /* namespace glm */
@@ -0,0 +1,321 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "glshim.h"
+
+#include <kodi/gui/gl/GL.h>
+
+#include <cstring>
+#include <set>
+#include <vector>
+
+namespace
+{
+
+struct sState
+{
+  std::string version = "4.6";
+  glshim::CallCounts calls;
+  unsigned int total = 0;
+
+  GLuint names = 0;
+  std::map<GLuint, std::vector<char>> buffers;
+  std::map<GLenum, GLuint> boundBuffers;
+  std::set<GLuint> liveBuffers;
+  std::set<GLuint> liveVertexArrays;
+  std::map<GLuint, GLuint> elementBuffers;
+  GLuint vertexArray = 0;
+  GLint framebuffer = 0;
+  GLint viewport[4] = {0, 0, 1920, 1080};
+  GLint locations = 0;
+  uintptr_t syncs = 0;
+};
+
+sState& state()
+{
+  static sState s;
+  return s;
+}
+
+void count(const char* function)
+{
+  state().calls[function]++;
+  state().total++;
+}
+
+void gen(GLsizei n, GLuint* names)
+{
+  for (GLsizei i = 0; i < n; i++)
+    names[i] = ++state().names;
+}
+
+std::vector<char>& bound_storage(GLenum target)
+{
+  return state().buffers[state().boundBuffers[target]];
+}
+
+}
+
+namespace glshim
+{
+
+void set_version(const char* version)
+{
+  state().version = version;
+}
+
+void reset()
+{
+  state().calls.clear();
+  state().total = 0;
+}
+
+const CallCounts& calls()
+{
+  return state().calls;
+}
+
+unsigned int count(const std::string& function)
+{
+  auto it = state().calls.find(function);
+  return it == state().calls.end() ? 0 : it->second;
+}
+
+unsigned int total()
+{
+  return state().total;
+}
+
+size_t live_buffers()
+{
+  return state().liveBuffers.size();
+}
+
+size_t live_vertex_arrays()
+{
+  return state().liveVertexArrays.size();
+}
+
+unsigned int vertex_array()
+{
+  return state().vertexArray;
+}
+
+unsigned int element_buffer(unsigned int vertexArray)
+{
+  auto it = state().elementBuffers.find(vertexArray);
+  return it == state().elementBuffers.end() ? 0 : it->second;
+}
+
+} /* namespace glshim */
+
+#define COUNT() count(__func__)
+
+extern "C"
+{
+
+/*
+ * State
+ */
+void GLAPIENTRY glEnable(GLenum) { COUNT(); }
+void GLAPIENTRY glDisable(GLenum) { COUNT(); }
+GLboolean GLAPIENTRY glIsEnabled(GLenum) { COUNT(); return GL_FALSE; }
+void GLAPIENTRY glBlendFunc(GLenum, GLenum) { COUNT(); }
+void GLAPIENTRY glClear(GLbitfield) { COUNT(); }
+
+void GLAPIENTRY glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  COUNT();
+  GLint* viewport = state().viewport;
+  viewport[0] = x;
+  viewport[1] = y;
+  viewport[2] = width;
+  viewport[3] = height;
+}
+
+void GLAPIENTRY glGetIntegerv(GLenum pname, GLint* params)
+{
+  COUNT();
+  switch (pname)
+  {
+    case GL_VIEWPORT:
+      memcpy(params, state().viewport, sizeof(state().viewport));
+      break;
+    case GL_VERTEX_ARRAY_BINDING:
+      *params = static_cast<GLint>(state().vertexArray);
+      break;
+    case GL_FRAMEBUFFER_BINDING:
+      *params = state().framebuffer;
+      break;
+    default:
+      *params = 0;
+      break;
+  }
+}
+
+const GLubyte* GLAPIENTRY glGetString(GLenum name)
+{
+  COUNT();
+  if (name != GL_VERSION)
+    return nullptr;
+  return reinterpret_cast<const GLubyte*>(state().version.c_str());
+}
+
+/*
+ * Buffers and vertex arrays
+ */
+void APIENTRY glGenBuffers(GLsizei n, GLuint* buffers)
+{
+  COUNT();
+  gen(n, buffers);
+  state().liveBuffers.insert(buffers, buffers + n);
+}
+
+void APIENTRY glDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+  COUNT();
+  for (GLsizei i = 0; i < n; i++)
+  {
+    state().buffers.erase(buffers[i]);
+    state().liveBuffers.erase(buffers[i]);
+  }
+}
+
+void APIENTRY glBindBuffer(GLenum target, GLuint buffer)
+{
+  COUNT();
+  state().boundBuffers[target] = buffer;
+
+  // Like in GL, the index buffer binding belongs to the vertex array object
+  if (target == GL_ELEMENT_ARRAY_BUFFER)
+    state().elementBuffers[state().vertexArray] = buffer;
+}
+
+void APIENTRY glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum)
+{
+  COUNT();
+  if (target == GL_ELEMENT_ARRAY_BUFFER)
+    state().calls["glBufferData(GL_ELEMENT_ARRAY_BUFFER)"]++;
+
+  std::vector<char>& storage = bound_storage(target);
+  storage.assign(size, 0);
+  if (data)
+    memcpy(storage.data(), data, size);
+}
+
+void APIENTRY glBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield)
+{
+  COUNT();
+  std::vector<char>& storage = bound_storage(target);
+  storage.assign(size, 0);
+  if (data)
+    memcpy(storage.data(), data, size);
+}
+
+void APIENTRY glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+  COUNT();
+  memcpy(bound_storage(target).data() + offset, data, size);
+}
+
+void* APIENTRY glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr, GLbitfield)
+{
+  COUNT();
+  return bound_storage(target).data() + offset;
+}
+
+GLboolean APIENTRY glUnmapBuffer(GLenum) { COUNT(); return GL_TRUE; }
+
+void APIENTRY glGenVertexArrays(GLsizei n, GLuint* arrays)
+{
+  COUNT();
+  gen(n, arrays);
+  state().liveVertexArrays.insert(arrays, arrays + n);
+}
+
+void APIENTRY glDeleteVertexArrays(GLsizei n, const GLuint* arrays)
+{
+  COUNT();
+  for (GLsizei i = 0; i < n; i++)
+  {
+    state().liveVertexArrays.erase(arrays[i]);
+    state().elementBuffers.erase(arrays[i]);
+  }
+}
+
+void APIENTRY glBindVertexArray(GLuint array)
+{
+  COUNT();
+  state().vertexArray = array;
+  state().boundBuffers[GL_ELEMENT_ARRAY_BUFFER] = state().elementBuffers[array];
+}
+
+void APIENTRY glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) { COUNT(); }
+void APIENTRY glEnableVertexAttribArray(GLuint) { COUNT(); }
+void APIENTRY glDisableVertexAttribArray(GLuint) { COUNT(); }
+void APIENTRY glVertexAttribDivisor(GLuint, GLuint) { COUNT(); }
+
+/*
+ * Drawing
+ */
+void GLAPIENTRY glDrawArrays(GLenum, GLint, GLsizei) { COUNT(); }
+void GLAPIENTRY glDrawElements(GLenum, GLsizei, GLenum, const GLvoid*) { COUNT(); }
+void APIENTRY glDrawElementsBaseVertex(GLenum, GLsizei, GLenum, const void*, GLint) { COUNT(); }
+void APIENTRY glDrawElementsInstanced(GLenum, GLsizei, GLenum, const void*, GLsizei) { COUNT(); }
+
+/*
+ * Textures and framebuffers
+ */
+void GLAPIENTRY glGenTextures(GLsizei n, GLuint* textures) { COUNT(); gen(n, textures); }
+void GLAPIENTRY glDeleteTextures(GLsizei, const GLuint*) { COUNT(); }
+void GLAPIENTRY glBindTexture(GLenum, GLuint) { COUNT(); }
+void GLAPIENTRY glActiveTexture(GLenum) { COUNT(); }
+void GLAPIENTRY glTexParameteri(GLenum, GLenum, GLint) { COUNT(); }
+void GLAPIENTRY glTexImage2D(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum,
+                             const GLvoid* pixels)
+{
+  COUNT();
+  if (pixels)
+    state().calls["glTexImage2D(pixels)"]++;
+}
+
+void APIENTRY glGenFramebuffers(GLsizei n, GLuint* framebuffers) { COUNT(); gen(n, framebuffers); }
+void APIENTRY glDeleteFramebuffers(GLsizei, const GLuint*) { COUNT(); }
+void APIENTRY glBindFramebuffer(GLenum, GLuint framebuffer) { COUNT(); state().framebuffer = framebuffer; }
+void APIENTRY glFramebufferTexture2D(GLenum, GLenum, GLenum, GLuint, GLint) { COUNT(); }
+GLenum APIENTRY glCheckFramebufferStatus(GLenum) { COUNT(); return GL_FRAMEBUFFER_COMPLETE; }
+
+/*
+ * Programs
+ */
+void APIENTRY glLinkProgram(GLuint) { COUNT(); }
+void APIENTRY glUseProgram(GLuint) { COUNT(); }
+void APIENTRY glBindAttribLocation(GLuint, GLuint, const GLchar*) { COUNT(); }
+GLint APIENTRY glGetAttribLocation(GLuint, const GLchar*) { COUNT(); return state().locations++; }
+GLint APIENTRY glGetUniformLocation(GLuint, const GLchar*) { COUNT(); return state().locations++; }
+void APIENTRY glUniform1f(GLint, GLfloat) { COUNT(); }
+void APIENTRY glUniform1i(GLint, GLint) { COUNT(); }
+void APIENTRY glUniform2fv(GLint, GLsizei, const GLfloat*) { COUNT(); }
+void APIENTRY glUniform3fv(GLint, GLsizei, const GLfloat*) { COUNT(); }
+void APIENTRY glUniform4fv(GLint, GLsizei, const GLfloat*) { COUNT(); }
+void APIENTRY glUniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat*) { COUNT(); }
+
+/*
+ * Synchronization and queries, everything is done right away
+ */
+GLsync APIENTRY glFenceSync(GLenum, GLbitfield) { COUNT(); return reinterpret_cast<GLsync>(++state().syncs); }
+GLenum APIENTRY glClientWaitSync(GLsync, GLbitfield, GLuint64) { COUNT(); return GL_ALREADY_SIGNALED; }
+void APIENTRY glDeleteSync(GLsync) { COUNT(); }
+
+void APIENTRY glGenQueries(GLsizei n, GLuint* ids) { COUNT(); gen(n, ids); }
+void APIENTRY glDeleteQueries(GLsizei, const GLuint*) { COUNT(); }
+void APIENTRY glBeginQuery(GLenum, GLuint) { COUNT(); }
+void APIENTRY glEndQuery(GLenum) { COUNT(); }
+void APIENTRY glGetQueryObjectiv(GLuint, GLenum, GLint* params) { COUNT(); *params = GL_TRUE; }
+void APIENTRY glGetQueryObjectui64v(GLuint, GLenum, GLuint64* params) { COUNT(); *params = 1000000; }
+
+}
@@ -0,0 +1,44 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+//! \brief A GL "driver" which does nothing but count the calls made to it.
+//!
+//! Buffers get real storage, so mapped writes work. Everything else answers
+//! like a context which has all it is asked for and never makes anyone wait.
+namespace glshim
+{
+
+//! Calls per function name since the last "reset". On top of that, uploads
+//! of index buffers get counted as "glBufferData(GL_ELEMENT_ARRAY_BUFFER)"
+//! and uploads of texture images as "glTexImage2D(pixels)".
+typedef std::map<std::string, unsigned int> CallCounts;
+
+//! \brief Version string of the context, "4.6" unless set otherwise.
+void set_version(const char* version);
+
+void reset();
+const CallCounts& calls();
+unsigned int count(const std::string& function);
+unsigned int total();
+
+//! \brief Buffers and vertex array objects generated and not yet deleted.
+size_t live_buffers();
+size_t live_vertex_arrays();
+
+//! \brief The bound vertex array object.
+unsigned int vertex_array();
+
+//! \brief Index buffer recorded in a vertex array object (0 for none).
+unsigned int element_buffer(unsigned int vertexArray);
+
+} /* namespace glshim */
@@ -0,0 +1,170 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+// Stand-in for the parts of Kodi's addon API the visualization uses. The
+// settings come from "kodi::test::settings", directories are listed from the
+// local file system.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#define ATTR_DLL_LOCAL
+
+enum ADDON_STATUS
+{
+  ADDON_STATUS_OK,
+  ADDON_STATUS_UNKNOWN,
+};
+
+enum AddonLog
+{
+  ADDON_LOG_DEBUG,
+  ADDON_LOG_INFO,
+  ADDON_LOG_WARNING,
+  ADDON_LOG_ERROR,
+  ADDON_LOG_FATAL,
+};
+
+namespace kodi
+{
+namespace test
+{
+
+//! \brief Values returned by the kodi::addon::GetSetting* functions.
+inline std::map<std::string, std::string>& settings()
+{
+  static std::map<std::string, std::string> values;
+  return values;
+}
+
+} /* namespace test */
+
+inline void Log(const AddonLog level, const char* format, ...)
+{
+  if (level < ADDON_LOG_WARNING)
+    return;
+
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+namespace addon
+{
+
+inline std::string GetSettingString(const std::string& name)
+{
+  return test::settings()[name];
+}
+
+inline bool GetSettingBoolean(const std::string& name)
+{
+  return test::settings()[name] == "true";
+}
+
+inline int GetSettingInt(const std::string& name)
+{
+  const std::string& value = test::settings()[name];
+  return value.empty() ? 0 : std::stoi(value);
+}
+
+inline std::string GetAddonPath(const std::string& append = "")
+{
+  return append;
+}
+
+class CAddonBase
+{
+public:
+  virtual ~CAddonBase() = default;
+  virtual ADDON_STATUS Create() { return ADDON_STATUS_OK; }
+};
+
+class VisualizationTrack
+{
+};
+
+class CInstanceVisualization
+{
+public:
+  virtual ~CInstanceVisualization() = default;
+  virtual bool Start(int, int, int, const std::string&) { return true; }
+  virtual void Stop() {}
+  virtual void AudioData(const float*, size_t) {}
+  virtual void Render() {}
+  virtual bool GetPresets(std::vector<std::string>&) { return false; }
+  virtual int GetActivePreset() { return -1; }
+  virtual bool PrevPreset() { return false; }
+  virtual bool NextPreset() { return false; }
+  virtual bool LoadPreset(int) { return false; }
+  virtual bool RandomPreset() { return false; }
+  virtual bool UpdateTrack(const VisualizationTrack&) { return false; }
+};
+
+} /* namespace addon */
+
+namespace vfs
+{
+
+class CDirEntry
+{
+public:
+  CDirEntry(const std::string& label = "", const std::string& path = "", bool folder = false)
+    : m_label(label), m_path(path), m_folder(folder)
+  {
+  }
+
+  const std::string& Label() const { return m_label; }
+  const std::string& Path() const { return m_path; }
+  bool IsFolder() const { return m_folder; }
+
+private:
+  std::string m_label;
+  std::string m_path;
+  bool m_folder;
+};
+
+//! Lists "path" like Kodi does: folders always, files only if "mask" is
+//! empty or lists their extension (e.g. ".jpg|.png", in any case).
+inline bool GetDirectory(const std::string& path, const std::string& mask,
+                         std::vector<CDirEntry>& items)
+{
+  auto lower = [](std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return text;
+  };
+  const std::string extensions = "|" + lower(mask) + "|";
+
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(path, error))
+  {
+    const std::string extension = lower(entry.path().extension().string());
+    if (!entry.is_directory() && !mask.empty() &&
+        (extension.empty() || extensions.find("|" + extension + "|") == std::string::npos))
+      continue;
+
+    items.emplace_back(entry.path().filename().string(), entry.path().string(),
+                       entry.is_directory());
+  }
+  return !error;
+}
+
+} /* namespace vfs */
+} /* namespace kodi */
+
+#define ADDONCREATOR(AddonClass)
@@ -0,0 +1,23 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+// Stand-in for Kodi's header: desktop GL only, every function is defined by
+// "glshim.cpp"
+
+#if !defined(HAS_GL)
+#define HAS_GL 1
+#endif
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#define GL_TYPE_STRING "GL"
+
+#define BUFFER_OFFSET(i) ((char*)nullptr + (i))
@@ -0,0 +1,75 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "GL.h"
+
+#include <string>
+
+namespace kodi
+{
+namespace gui
+{
+namespace gl
+{
+
+//! \brief Stand-in for Kodi's shader program: nothing gets compiled, but
+//! the hooks and the glUseProgram calls happen where Kodi makes them.
+class CShaderProgram
+{
+public:
+  virtual ~CShaderProgram() = default;
+
+  bool LoadShaderFiles(const std::string&, const std::string&) { return true; }
+
+  bool CompileAndLink(const std::string& = "", const std::string& = "",
+                      const std::string& = "", const std::string& = "")
+  {
+    static GLuint programs = 0;
+    m_program = ++programs;
+    glLinkProgram(m_program);
+    OnCompiledAndLinked();
+    return true;
+  }
+
+  bool EnableShader()
+  {
+    if (!ShaderOK())
+      return false;
+
+    glUseProgram(m_program);
+    if (OnEnabled())
+      return true;
+
+    glUseProgram(0);
+    return false;
+  }
+
+  void DisableShader()
+  {
+    if (!ShaderOK())
+      return;
+
+    glUseProgram(0);
+    OnDisabled();
+  }
+
+  bool ShaderOK() const { return m_program != 0; }
+  GLuint ProgramHandle() { return m_program; }
+
+  virtual void OnCompiledAndLinked() {}
+  virtual bool OnEnabled() { return false; }
+  virtual void OnDisabled() {}
+
+private:
+  GLuint m_program = 0;
+};
+
+} /* namespace gl */
+} /* namespace gui */
+} /* namespace kodi */
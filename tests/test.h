@@ -0,0 +1,38 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <cstdio>
+
+//! \brief Minimal checks for the standalone tests, a test passes if its
+//! main() returns test_result().
+
+inline int& test_failures()
+{
+  static int failures = 0;
+  return failures;
+}
+
+inline bool test_check(bool ok, const char* what, const char* file, int line)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+    test_failures()++;
+  }
+  return ok;
+}
+
+inline int test_result()
+{
+  if (test_failures())
+    fprintf(stderr, "%d check(s) failed\n", test_failures());
+  return test_failures() ? 1 : 0;
+}
+
+#define CHECK(condition) test_check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,194 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+// The audio path must not touch the heap once it is warmed up. Every
+// operator new is counted, and where the linker can wrap them (see
+// CMakeLists.txt) also the malloc family calls of our code and kissfft,
+// which is what AlignedAllocator and kiss_fft_alloc use.
+
+#include "test.h"
+
+#include "analyser.h"
+#include "mrfft.h"
+#include "spscring.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<size_t> g_allocations{0};
+}
+
+void* operator new(size_t size)
+{
+  g_allocations++;
+  if (void* ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+#if defined(WRAP_MALLOC)
+extern "C"
+{
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+int __real_posix_memalign(void** ptr, size_t alignment, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+  g_allocations++;
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+  g_allocations++;
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+  g_allocations++;
+  return __real_realloc(ptr, size);
+}
+
+int __wrap_posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+  g_allocations++;
+  return __real_posix_memalign(ptr, alignment, size);
+}
+}
+#endif
+
+namespace
+{
+
+// Interleaved test signal: a tone per channel over a little noise
+aligned_vector<float> make_signal(size_t frames, size_t channels)
+{
+  aligned_vector<float> signal(frames * channels);
+  unsigned int noise = 1;
+  for (size_t n = 0; n < frames; n++)
+  {
+    for (size_t c = 0; c < channels; c++)
+    {
+      noise = noise * 1664525u + 1013904223u;
+      signal[n * channels + c] = 0.5f * std::sin(0.01f * (c + 1) * n) +
+                                 0.01f * (static_cast<float>(noise >> 8) / (1 << 24) - 0.5f);
+    }
+  }
+  return signal;
+}
+
+void test_mrfft(MRFFT::Mode mode, MRFFT::Window window)
+{
+  const int size = 2048;
+  MRFFT fft(size, window, mode);
+  aligned_vector<float> input = make_signal(size, fft.channels());
+  aligned_vector<float> output(fft.channels() * size / 2);
+
+  // Warm up, get_kernels() detects the CPU on first use
+  fft.calc(input.data());
+
+  g_allocations = 0;
+  for (int i = 0; i < 100; i++)
+  {
+    fft.calc(input.data());
+    fft.calc(input.data(), output.data());
+  }
+  CHECK(g_allocations == 0);
+}
+
+void test_analyser(size_t channels)
+{
+  CSpectrumAnalyser analyser;
+  analyser.configure(2048, 512, 44100, channels, 96, MRFFT::Window::Hann);
+
+  // Chunk sizes as odd as Kodi's callbacks, including more than a window
+  static const size_t chunks[] = {480, 512, 1024, 7, 4096, 1};
+  aligned_vector<float> signal = make_signal(4096, channels);
+
+  auto feed = [&](int rounds) {
+    size_t updates = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+      for (size_t frames : chunks)
+        updates += analyser.process(signal.data(), frames);
+    }
+    return updates;
+  };
+
+  feed(2);
+
+  g_allocations = 0;
+  const size_t updates = feed(50);
+  CHECK(g_allocations == 0);
+  CHECK(updates > 0);
+}
+
+void test_ring()
+{
+  CSPSCRing<float> ring;
+  ring.resize(8192);
+  aligned_vector<float> data = make_signal(1024, 2);
+  aligned_vector<float> out(data.size());
+
+  g_allocations = 0;
+  for (int i = 0; i < 1000; i++)
+  {
+    ring.push(data.data(), data.size() - i % 7, 2);
+    ring.pop(out.data(), out.size());
+  }
+  CHECK(g_allocations == 0);
+}
+
+} // namespace
+
+int main()
+{
+  for (MRFFT::Mode mode : {MRFFT::Mode::Separate, MRFFT::Mode::Packed, MRFFT::Mode::Mono})
+  {
+    test_mrfft(mode, MRFFT::Window::None);
+    test_mrfft(mode, MRFFT::Window::Hann);
+  }
+
+  for (size_t channels : {1, 2, 6})
+    test_analyser(channels);
+
+  test_ring();
+
+  return test_result();
+}
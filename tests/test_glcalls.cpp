@@ -0,0 +1,327 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+// Runs the whole visualization against a GL shim which counts the calls
+// made per frame. Once the background is cached, every frame must make the
+// same few calls, and no frame may respecify vertex layouts, re-upload
+// index buffers or look up shader locations. Kodi's vertex array object
+// must stay as it was, and a restart must not leak GL objects.
+
+#include "test.h"
+
+#include "glshim.h"
+#include "pictureit.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+
+// Calls of a frame which only draws the cached background and the bars
+const unsigned int MAX_STEADY_CALLS = 30;
+
+// Calls which belong to setting things up, never to a frame. Programs upload
+// their matrices when they are first used, which steady frames would show.
+const char* const SETUP_CALLS[] = {
+  "glBufferData(GL_ELEMENT_ARRAY_BUFFER)",
+  "glVertexAttribPointer",
+  "glEnableVertexAttribArray",
+  "glDisableVertexAttribArray",
+  "glVertexAttribDivisor",
+  "glGenBuffers",
+  "glGenVertexArrays",
+  "glLinkProgram",
+  "glGetUniformLocation",
+  "glGetAttribLocation",
+};
+
+const int FADE_TIME_MS = 100;
+const int TIMEOUT_MS = 10000;
+const int IMAGES = 4;
+
+struct sFrame
+{
+  glshim::CallCounts calls;
+  unsigned int total;
+
+  unsigned int count(const std::string& function) const
+  {
+    auto it = calls.find(function);
+    return it == calls.end() ? 0 : it->second;
+  }
+
+  unsigned int draws() const
+  {
+    return count("glDrawArrays") + count("glDrawElements") +
+           count("glDrawElementsBaseVertex") + count("glDrawElementsInstanced");
+  }
+};
+
+void print_frame(const char* what, const sFrame& frame)
+{
+  fprintf(stderr, "%s: %u calls\n", what, frame.total);
+  for (const auto& call : frame.calls)
+    fprintf(stderr, "  %-40s %u\n", call.first.c_str(), call.second);
+}
+
+// A small opaque grey PNG, its pixels deflated as a single stored block
+void write_png(const std::string& path, unsigned char shade)
+{
+  const unsigned int size = 4;
+  typedef std::vector<unsigned char> Bytes;
+
+  auto put32 = [](Bytes& bytes, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+      bytes.push_back(static_cast<unsigned char>(value >> shift));
+  };
+
+  // Every row starts with its filter type (none)
+  Bytes pixels;
+  for (unsigned int y = 0; y < size; y++)
+  {
+    pixels.push_back(0);
+    pixels.insert(pixels.end(), 3 * size, shade);
+  }
+
+  Bytes zlib = {0x78, 0x01, 0x01};
+  const uint16_t length = static_cast<uint16_t>(pixels.size());
+  zlib.insert(zlib.end(), {static_cast<unsigned char>(length), static_cast<unsigned char>(length >> 8),
+                           static_cast<unsigned char>(~length), static_cast<unsigned char>(~length >> 8)});
+  zlib.insert(zlib.end(), pixels.begin(), pixels.end());
+  uint32_t a = 1, b = 0;
+  for (unsigned char byte : pixels)
+  {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  put32(zlib, (b << 16) | a);
+
+  Bytes header;
+  put32(header, size);
+  put32(header, size);
+  header.insert(header.end(), {8, 2, 0, 0, 0});
+
+  Bytes png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  auto chunk = [&](const char* type, const Bytes& data) {
+    put32(png, static_cast<uint32_t>(data.size()));
+    Bytes crcd(type, type + 4);
+    crcd.insert(crcd.end(), data.begin(), data.end());
+    uint32_t crc = 0xffffffff;
+    for (unsigned char byte : crcd)
+    {
+      crc ^= byte;
+      for (int bit = 0; bit < 8; bit++)
+        crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+    png.insert(png.end(), crcd.begin(), crcd.end());
+    put32(png, ~crc);
+  };
+  chunk("IHDR", header);
+  chunk("IDAT", zlib);
+  chunk("IEND", {});
+
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(png.data()), png.size());
+}
+
+class CFrameRunner
+{
+public:
+  explicit CFrameRunner(CVisPictureIt& vis) : m_vis(vis)
+  {
+    for (size_t i = 0; i < m_audio.size() / 2; i++)
+      m_audio[2 * i] = m_audio[2 * i + 1] = 0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 1000.0f * i / 44100.0f);
+  }
+
+  //! Render one frame (after handing over 10 ms of audio) and return its calls
+  const sFrame& render()
+  {
+    m_vis.AudioData(m_audio.data(), m_audio.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    glshim::reset();
+    m_vis.Render();
+    m_frames.push_back({glshim::calls(), glshim::total()});
+    return m_frames.back();
+  }
+
+  //! Render until a frame uploads an image
+  bool until_image()
+  {
+    for (auto end = deadline(); CTimeline::Clock::now() < end;)
+    {
+      if (render().count("glTexImage2D(pixels)"))
+        return true;
+    }
+    return false;
+  }
+
+  //! Render until "count" frames in a row draw the cached background plus
+  //! the bars and make the very same calls. Without the strip, fading in
+  //! draws as much as that, so the cache must have been rendered first.
+  bool until_steady(int count)
+  {
+    int same = 0;
+    bool rendered = false;
+    for (auto end = deadline(); CTimeline::Clock::now() < end;)
+    {
+      const sFrame& frame = render();
+      rendered |= frame.count("glBindFramebuffer") > 0;
+      const bool cached = rendered && frame.draws() == 2 && !frame.count("glBindFramebuffer");
+      if (!cached)
+        same = 0;
+      else if (same && frame.calls == m_frames[m_frames.size() - 2].calls)
+        same++;
+      else
+        same = 1;
+
+      if (same == count)
+        return true;
+    }
+    return false;
+  }
+
+  const std::vector<sFrame>& frames() const { return m_frames; }
+
+private:
+  static CTimeline::Clock::time_point deadline()
+  {
+    return CTimeline::Clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+  }
+
+  CVisPictureIt& m_vis;
+  std::vector<float> m_audio = std::vector<float>(2 * 441);
+  std::vector<sFrame> m_frames;
+};
+
+void test_renderer(const std::string& imageDir, const char* version, int renderer, bool strip)
+{
+  fprintf(stderr, "GL %s, bar renderer %i%s\n", version, renderer, strip ? "" : ", no strip");
+  glshim::set_version(version);
+
+  auto& settings = kodi::test::settings();
+  settings["presets_root_dir"] = imageDir;
+  settings["update_on_new_track"] = "true";
+  settings["update_by_interval"] = "false";
+  settings["img_update_interval"] = "3600";
+  settings["fade_time_ms"] = std::to_string(FADE_TIME_MS);
+  settings["frame_budget_ms"] = "0";
+  settings["vis_enabled"] = "true";
+  settings["vis_bg_enabled"] = strip ? "true" : "false";
+  settings["vis_half_width"] = "90";
+  settings["vis_bottom_edge"] = "1";
+  settings["vis_bar_count"] = "96";
+  settings["vis_attack_ms"] = "40";
+  settings["vis_release_ms"] = "300";
+  settings["vis_fft_window"] = "0";
+  settings["vis_fft_size"] = "2048";
+  settings["vis_fft_overlap"] = "75";
+  settings["vis_bar_renderer"] = std::to_string(renderer);
+
+  // Kodi renders with a vertex array object (and index buffer) of its own
+  GLuint kodiVAO, kodiIndices;
+  glGenVertexArrays(1, &kodiVAO);
+  glGenBuffers(1, &kodiIndices);
+  glBindVertexArray(kodiVAO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, kodiIndices);
+  const size_t buffers = glshim::live_buffers();
+  const size_t vertexArrays = glshim::live_vertex_arrays();
+
+  CVisPictureIt vis;
+  CHECK(vis.Create() == ADDON_STATUS_OK);
+  std::vector<std::string> presets;
+  CHECK(vis.GetPresets(presets));
+
+  // A new audio format starts the visualization again without a stop
+  if (!CHECK(vis.Start(6, 48000, 16, "")) || !CHECK(vis.Start(2, 44100, 16, "")))
+    return;
+
+  CFrameRunner runner(vis);
+
+  // The first image fades in, after that the background is cached
+  CHECK(runner.until_image());
+  if (CHECK(runner.until_steady(20)))
+  {
+    const sFrame& steady = runner.frames().back();
+    if (!CHECK(steady.total <= MAX_STEADY_CALLS))
+      print_frame("Steady frame", steady);
+    CHECK(glshim::vertex_array() == kodiVAO);
+  }
+  const glshim::CallCounts firstSteady = runner.frames().back().calls;
+
+  // The next image crossfades over it in a single pass
+  const size_t crossfadeStart = runner.frames().size();
+  vis.UpdateTrack(kodi::addon::VisualizationTrack());
+  CHECK(runner.until_image());
+  CHECK(runner.until_steady(20));
+  CHECK(runner.frames().back().calls == firstSteady);
+
+  int crossfades = 0;
+  for (size_t i = crossfadeStart; i < runner.frames().size(); i++)
+  {
+    const sFrame& frame = runner.frames()[i];
+    if (!frame.count("glActiveTexture"))
+      continue;
+
+    crossfades++;
+    if (!CHECK(frame.draws() == (strip ? 3u : 2u)))
+      print_frame("Crossfade frame", frame);
+  }
+  CHECK(crossfades > 0);
+
+  for (const sFrame& frame : runner.frames())
+  {
+    bool clean = true;
+    for (const char* call : SETUP_CALLS)
+      clean &= CHECK(frame.count(call) == 0);
+    if (!clean)
+    {
+      print_frame("Frame setting things up", frame);
+      break;
+    }
+  }
+
+  vis.Stop();
+  CHECK(glshim::element_buffer(kodiVAO) == kodiIndices);
+  CHECK(glshim::live_buffers() == buffers);
+  CHECK(glshim::live_vertex_arrays() == vertexArrays);
+  glDeleteBuffers(1, &kodiIndices);
+  glDeleteVertexArrays(1, &kodiVAO);
+}
+
+}
+
+int main()
+{
+  char dirTemplate[] = "/tmp/pictureit-glcalls-XXXXXX";
+  if (!mkdtemp(dirTemplate))
+    return 1;
+  const std::string imageDir = dirTemplate;
+  for (int i = 0; i < IMAGES; i++)
+    write_png(imageDir + "/" + std::to_string(i) + ".png", static_cast<unsigned char>(50 * i));
+
+  // Kodi only lists the image types the add-on asks for
+  std::ofstream(imageDir + "/notes.txt") << "not an image";
+
+  // 4.6: persistently mapped stream buffer, 3.3: unsynchronized mapping
+  for (const char* version : {"4.6", "3.3"})
+  {
+    for (int renderer = 1; renderer <= 3; renderer++)
+      test_renderer(imageDir, version, renderer, true);
+  }
+
+  // Without the strip the image alone is cached
+  test_renderer(imageDir, "4.6", 1, false);
+
+  std::filesystem::remove_all(imageDir);
+  return test_result();
+}
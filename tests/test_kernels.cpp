@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+// The downmix of the kernels picked for this CPU must match the scalar one
+// for every channel count and for frame counts which leave a tail.
+
+#include "test.h"
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+
+const float TOLERANCE = 1e-6f;
+
+void test_downmix(size_t channels, size_t frames)
+{
+  // A different level per channel and frame, so mixing up either would show
+  std::vector<float> input(channels * frames);
+  for (size_t i = 0; i < input.size(); i++)
+    input[i] = std::sin(0.37f * i) + 0.01f * (i % channels);
+
+  float coeffs[2 * DOWNMIX_MAX_CHANNELS] = {};
+  for (size_t c = 0; c < channels && c < DOWNMIX_MAX_CHANNELS; c++)
+  {
+    coeffs[c] = 0.1f * (c + 1);
+    coeffs[DOWNMIX_MAX_CHANNELS + c] = 0.8f - 0.1f * c;
+  }
+
+  std::vector<float> expected(2 * frames);
+  std::vector<float> actual(2 * frames);
+  get_scalar_kernels().downmix(input.data(), channels, coeffs, expected.data(), frames);
+  get_kernels().downmix(input.data(), channels, coeffs, actual.data(), frames);
+
+  float error = 0.0f;
+  for (size_t i = 0; i < expected.size(); i++)
+    error = std::max(error, std::fabs(actual[i] - expected[i]));
+  if (!CHECK(error <= TOLERANCE))
+    fprintf(stderr, "  %zu channels, %zu frames: error %g\n", channels, frames, error);
+}
+
+} // namespace
+
+int main()
+{
+  fprintf(stderr, "Testing the %s kernels\n", get_kernels().name);
+  for (size_t channels = 3; channels <= 10; channels++)
+  {
+    for (size_t frames : {0, 1, 3, 4, 5, 7, 8, 9, 480, 1023})
+      test_downmix(channels, frames);
+  }
+
+  return test_result();
+}
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+// MRFFT::Mode::Packed must match the two RFFTs of Mode::Separate.
+
+#include "test.h"
+
+#include "mrfft.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+const float TOLERANCE = 1e-6f;
+
+// Different content per channel, so mixing them up would show: tones, DC and
+// Nyquist on the left, noise on the right
+aligned_vector<float> make_signal(size_t frames)
+{
+  aligned_vector<float> signal(2 * frames);
+  unsigned int noise = 1;
+  for (size_t n = 0; n < frames; n++)
+  {
+    noise = noise * 1664525u + 1013904223u;
+    signal[2 * n] = 0.4f * std::sin(0.05f * n) + 0.2f * std::cos(1.3f * n) + 0.1f +
+                    0.05f * (n % 2 ? -1.0f : 1.0f);
+    signal[2 * n + 1] = static_cast<float>(noise >> 8) / (1 << 24) - 0.5f;
+  }
+  return signal;
+}
+
+void test_packed(int size, MRFFT::Window window)
+{
+  MRFFT separate(size, window, MRFFT::Mode::Separate);
+  MRFFT packed(size, window, MRFFT::Mode::Packed);
+  aligned_vector<float> input = make_signal(size);
+
+  aligned_vector<float> expected(size);
+  aligned_vector<float> actual(size);
+  separate.calc(input.data(), expected.data());
+  packed.calc(input.data(), actual.data());
+
+  float maxError = 0.0f;
+  for (int i = 0; i < size; i++)
+    maxError = std::max(maxError, std::fabs(expected[i] - actual[i]));
+
+  if (!CHECK(maxError <= TOLERANCE))
+    fprintf(stderr, "  size %d, window %d: error %g\n", size, static_cast<int>(window), maxError);
+}
+
+} // namespace
+
+int main()
+{
+  for (int size : {256, 2048, 8192})
+  {
+    for (MRFFT::Window window : {MRFFT::Window::None, MRFFT::Window::Hann,
+                                 MRFFT::Window::BlackmanHarris, MRFFT::Window::FlatTop})
+      test_packed(size, window);
+  }
+
+  return test_result();
+}
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+// Producer/consumer stress test of CTripleBuffer, meant to run under
+// ThreadSanitizer (see PICTUREIT_TSAN in CMakeLists.txt). Every frame is
+// filled with its sequence number, so the consumer can tell a torn or
+// reordered frame apart from a complete one.
+
+#include "test.h"
+
+#include "aligned.h"
+#include "triplebuffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace
+{
+
+const size_t BAR_COUNT = 96;
+const uint32_t FRAMES = 200000;
+
+// Like the frames handed from AudioData to Render
+struct sFrame
+{
+  aligned_vector<float> heights;
+  uint32_t sequence = 0;
+};
+
+} // namespace
+
+int main()
+{
+  CTripleBuffer<sFrame> buffer;
+  sFrame empty;
+  empty.heights.assign(BAR_COUNT, 0.0f);
+  buffer.reset(empty);
+
+  std::atomic<bool> done{false};
+
+  std::thread producer([&]() {
+    for (uint32_t sequence = 1; sequence <= FRAMES; sequence++)
+    {
+      sFrame& frame = buffer.write_buffer();
+      for (auto& height : frame.heights)
+        height = static_cast<float>(sequence);
+      frame.sequence = sequence;
+      buffer.publish();
+    }
+    done = true;
+  });
+
+  uint32_t last = 0;
+  size_t received = 0;
+  size_t torn = 0;
+  size_t reordered = 0;
+
+  // One more update after the producer finished picks up the last frame
+  for (bool finished = false; !finished;)
+  {
+    finished = done;
+    if (!buffer.update())
+      continue;
+
+    const sFrame& frame = buffer.read_buffer();
+    for (float height : frame.heights)
+    {
+      if (height != static_cast<float>(frame.sequence))
+      {
+        torn++;
+        break;
+      }
+    }
+    if (frame.sequence <= last)
+      reordered++;
+
+    last = frame.sequence;
+    received++;
+  }
+
+  producer.join();
+
+  CHECK(torn == 0);
+  CHECK(reordered == 0);
+  CHECK(received > 0);
+  CHECK(last == FRAMES);
+
+  return test_result();
+}
@@ -0,0 +1,30 @@
+// The "#version" line is put in front of this by the addon
+
+// Attributes
+// Corner of the static bar mesh (x: 0 left / 1 right edge, y: 0 bottom /
+// 1 top edge, z: 1 for the mirrored counterpart)
+in vec3 a_corner;
+
+// Per bar (instance): left edge and height
+in float a_offset;
+in float a_height;
+
+// Uniforms
+uniform mat4 u_projectionMatrix;
+uniform mat4 u_modelViewMatrix;
+
+// x: width of a bar (without its gaps), y: bottom edge
+uniform vec2 u_layout;
+
+// Varyings
+out vec4 v_frontColor;
+
+void main ()
+{
+  float x = a_offset + a_corner.x * u_layout.x;
+  x = mix(x, -x, a_corner.z);
+  float y = u_layout.y - a_corner.y * a_height;
+
+  gl_Position = u_projectionMatrix * u_modelViewMatrix * vec4(x, y, 0.0, 1.0);
+  v_frontColor = vec4(1.0);
+}
@@ -0,0 +1,43 @@
+// The "#version" line is put in front of this by the addon
+
+// Uniforms
+uniform mat4 u_projectionMatrix;
+uniform mat4 u_modelViewMatrix;
+
+// Height of every bar, four bars per element
+uniform vec4 u_heights[64];
+
+// x: half width of the spectrum, y: bottom edge, z: amount of bars
+uniform vec3 u_layout;
+
+// Varyings
+out vec4 v_frontColor;
+
+// Corner of the quad used by each of the six vertices of its two triangles
+// (0: top left, 1: top right, 2: bottom right, 3: bottom left)
+const int corners[6] = int[6](0, 1, 2, 0, 2, 3);
+
+void main ()
+{
+  // Every bar is made of two quads: the bar itself on the left and its
+  // mirrored counterpart on the right
+  int quad = gl_VertexID / 6;
+  int corner = corners[gl_VertexID - quad * 6];
+  int bar = quad / 2;
+
+  float bar_width = u_layout.x / u_layout.z;
+  float x;
+  if (corner == 1 || corner == 2)
+    x = -u_layout.x + float(bar + 1) * bar_width - bar_width / 4.0;
+  else
+    x = -u_layout.x + float(bar) * bar_width + bar_width / 4.0;
+  if (quad - bar * 2 == 1)
+    x = -x;
+
+  float y = u_layout.y;
+  if (corner < 2)
+    y -= u_heights[bar / 4][bar - (bar / 4) * 4];
+
+  gl_Position = u_projectionMatrix * u_modelViewMatrix * vec4(x, y, 0.0, 1.0);
+  v_frontColor = vec4(1.0);
+}
@@ -1,17 +1,35 @@
-#version 130
+// The "#version" line and the variant ("#define TEXTURED" for the image
+// layers, plus "#define CROSSFADE" for crossfading two of them) are put in
+// front of this by the addon
 
 // Uniforms
+#ifdef TEXTURED
 uniform sampler2D u_texUnit;
-uniform int u_textureId;
+#endif
+#ifdef CROSSFADE
+uniform sampler2D u_texUnit2;
+uniform float u_fade;
+#endif
 
 // Varyings
 in vec4 v_frontColor;
+#ifdef TEXTURED
 in vec2 v_texCoord0;
+#endif
 
 void main()
 {
-  if (u_textureId != 0)
-    gl_FragColor = texture2D(u_texUnit, v_texCoord0) * v_frontColor;
-  else
-    gl_FragColor = v_frontColor;
+#if defined(CROSSFADE)
+  vec4 current = texture2D(u_texUnit, v_texCoord0);
+  vec4 next = texture2D(u_texUnit2, v_texCoord0);
+  // Premultiplied, so transparent pixels don't bring their color into the
+  // mix (blended with GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+  current.rgb *= current.a;
+  next.rgb *= next.a;
+  gl_FragColor = mix(current, next, u_fade) * v_frontColor;
+#elif defined(TEXTURED)
+  gl_FragColor = texture2D(u_texUnit, v_texCoord0) * v_frontColor;
+#else
+  gl_FragColor = v_frontColor;
+#endif
 }
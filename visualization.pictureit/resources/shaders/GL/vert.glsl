@@ -1,9 +1,13 @@
-#version 130
+// The "#version" line and the variant ("#define TEXTURED" for the image
+// layers, plus "#define CROSSFADE" for crossfading two of them) are put in
+// front of this by the addon
 
 // Attributes
 in vec4 a_vertex;
 in vec4 a_color;
+#ifdef TEXTURED
 in vec2 a_coord;
+#endif
 
 // Uniforms
 uniform mat4 u_projectionMatrix;
@@ -11,12 +15,16 @@ uniform mat4 u_modelViewMatrix;
 
 // Varyings
 out vec4 v_frontColor;
+#ifdef TEXTURED
 out vec2 v_texCoord0;
+#endif
 
 void main ()
 {
   gl_Position = u_projectionMatrix * u_modelViewMatrix * a_vertex;
 
+#ifdef TEXTURED
   v_texCoord0 = a_coord;
+#endif
   v_frontColor = a_color;
 }
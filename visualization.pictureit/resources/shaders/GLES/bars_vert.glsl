@@ -0,0 +1,54 @@
+// The "#version" line is put in front of this by the addon
+
+precision highp float;
+
+// Attributes
+// Index of the vertex, GLSL ES 1.00 has no gl_VertexID
+attribute float a_index;
+
+// Uniforms
+uniform mat4 u_projectionMatrix;
+uniform mat4 u_modelViewMatrix;
+
+// Height of every bar, four bars per element
+uniform vec4 u_heights[64];
+
+// x: half width of the spectrum, y: bottom edge, z: amount of bars
+uniform vec3 u_layout;
+
+// Varyings
+varying vec4 v_frontColor;
+
+void main ()
+{
+  // Every bar is made of two quads: the bar itself on the left and its
+  // mirrored counterpart on the right. The six vertices of a quad's two
+  // triangles use the corners 0, 1, 2, 0, 2, 3 (top left, top right,
+  // bottom right, bottom left).
+  float quad = floor(a_index / 6.0 + 0.01);
+  float vertex = a_index - quad * 6.0;
+  float corner = vertex < 2.5 ? vertex : vertex - 2.0;
+  if (vertex < 3.5 && vertex > 2.5)
+    corner = 0.0;
+  float bar = floor(quad / 2.0 + 0.01);
+
+  float bar_width = u_layout.x / u_layout.z;
+  float x;
+  if (corner > 0.5 && corner < 2.5)
+    x = -u_layout.x + (bar + 1.0) * bar_width - bar_width / 4.0;
+  else
+    x = -u_layout.x + bar * bar_width + bar_width / 4.0;
+  if (quad - bar * 2.0 > 0.5)
+    x = -x;
+
+  float y = u_layout.y;
+  if (corner < 1.5)
+  {
+    float element = floor(bar / 4.0 + 0.01);
+    vec4 select = vec4(equal(vec4(0.0, 1.0, 2.0, 3.0), vec4(bar - element * 4.0)));
+    y -= dot(u_heights[int(element)], select);
+  }
+
+  gl_Position = u_projectionMatrix * u_modelViewMatrix * vec4(x, y, 0.0, 1.0);
+  v_frontColor = vec4(1.0);
+}
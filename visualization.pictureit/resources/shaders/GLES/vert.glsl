@@ -1,11 +1,15 @@
-#version 100
+// The "#version" line and the variant ("#define TEXTURED" for the image
+// layers, plus "#define CROSSFADE" for crossfading two of them) are put in
+// front of this by the addon
 
 precision mediump float;
 
 // Attributes
 attribute vec4 a_vertex;
 attribute vec4 a_color;
+#ifdef TEXTURED
 attribute vec2 a_coord;
+#endif
 
 // Uniforms
 uniform mat4 u_projectionMatrix;
@@ -13,12 +17,16 @@ uniform mat4 u_modelViewMatrix;
 
 // Varyings
 varying vec4 v_frontColor;
+#ifdef TEXTURED
 varying vec2 v_texCoord0;
+#endif
 
 void main ()
 {
   gl_Position = u_projectionMatrix * u_modelViewMatrix * a_vertex;
 
+#ifdef TEXTURED
   v_texCoord0 = a_coord;
+#endif
   v_frontColor = a_color;
 }